@@ -0,0 +1,70 @@
+#ifndef BOOTCLUSTERSTORE_H
+#define BOOTCLUSTERSTORE_H
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+using namespace std;
+
+#define BOOTSTORE_BLOCK 4096 // Nodes per block on disk
+
+// Module of every node in every bootstrap partition. Each bootstrap is kept
+// as a column of labels in the smallest width that fits its number of
+// modules, 1, 2 or 4 bytes, so 1000 bootstraps of 10M nodes with fewer than
+// 256 modules take 10 GB instead of 40 GB.
+// Without a file name the columns are kept in memory. With a file name they
+// are appended to file.cols when they are put, and finish appends the
+// bootstraps put since the last finish to file as one segment in blocks of
+// BOOTSTORE_BLOCK nodes, with the columns of the bootstraps of a block next
+// to each other, and memory-maps it. The bootstraps of a node are then read
+// from one block per segment and the operating system keeps only the blocks
+// in use in memory. Repeated calls of finish, as by --early-stop, only write
+// the new bootstraps, unless a written bootstrap was put again. Both files
+// are removed when the store is deleted.
+class BootClusterStore{
+ public:
+  BootClusterStore(int Nnode,int maxBoots,string file);
+  ~BootClusterStore();
+  // Store the partition of a bootstrap, in any order and more than once
+  void put(int bootstrap,vector<int> &cluster);
+  // Make bootstraps 0..Nboots-1 readable, they must all have been put
+  void finish(int Nboots);
+  // Module of node in all readable bootstraps
+  void labels(int node,int *out);
+
+  int Nnode;
+  int maxBoots;
+  int Nboots;
+
+ private:
+  int decode(const unsigned char *p,int w){
+    if(w == 1)
+      return p[0];
+    if(w == 2){
+      unsigned short label;
+      memcpy(&label,p,2);
+      return label;
+    }
+    int label;
+    memcpy(&label,p,4);
+    return label;
+  }
+
+  vector<int> width;
+  vector<vector<unsigned char> > columns; // In memory
+
+  string file; // On disk
+  FILE *cols;
+  vector<long long> colStart;
+  vector<int> prefix; // Bytes per node of the bootstraps before k
+  int Nwritten; // Bootstraps in file
+  vector<int> segStart; // First bootstrap of each segment of file
+  vector<long long> segOffset;
+  long long fileSize;
+  int fd;
+  size_t mapSize;
+  unsigned char *mapped;
+};
+
+#endif
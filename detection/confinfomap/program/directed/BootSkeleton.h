@@ -0,0 +1,46 @@
+#ifndef BOOTSKELETON_H
+#define BOOTSKELETON_H
+
+#include <vector>
+#include <map>
+#include "Random.h"
+using namespace std;
+
+#define GAUSS_BATCH 256 // Normal numbers generated in one loop
+
+// Links of the network in compressed sparse row form, built once and shared
+// by all bootstrap networks, which only differ in the link weights. Self-links
+// are left out. The links of node i are out.nb[p] for p from out.start[i] to
+// out.start[i+1]-1, in the order of the link map, and out.link[p] is their
+// position in mean, sd and weight. For directed networks the in-links of each
+// node are in the same way in in, for undirected networks every link is in
+// the row of both its nodes in out and in is empty.
+// resample draws all weights of a bootstrap network at once as
+// mean + sd*z, with z standard normal numbers from batches of Box-Muller
+// transforms. Links whose weight is not positive are left out of that
+// bootstrap network by the caller, the rows are never changed.
+class BootSkeleton{
+ public:
+  BootSkeleton(map<int,map<int,double> > &Links,int Nnode,bool directed);
+  void resample(Random &R);
+
+  class Rows{
+   public:
+    vector<int> start;
+    vector<int> nb;
+    vector<int> link;
+  };
+
+  int Nnode;
+  int Nlinks;
+  Rows out;
+  Rows in;
+  vector<double> mean;
+  vector<double> sd;
+  vector<double> weight;
+
+ private:
+  void fillRows(Rows &rows,vector<int> &from,vector<int> &to,bool both);
+};
+
+#endif
@@ -0,0 +1,129 @@
+#include "CoCluster.h"
+#include <algorithm>
+
+typedef unsigned long long Word;
+
+void coClusterModules(int M,vector<vector<int> > &significantNodes,BootClusterStore &bootClusters,vector<vector<int> > &coexistCount,vector<multimap<int,pair<int,vector<int> >,greater<int> > > &coExist){
+
+  int Nboots = bootClusters.Nboots;
+  int Nwords = (Nboots + 63)/64;
+
+  // Bootstrap module of every module in every bootstrap, -1 if it is split
+  vector<int> label(static_cast<size_t>(M)*Nboots);
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+  {
+    vector<int> nodeLabel(Nboots);
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+    for(int m=0;m<M;m++){
+      int Nsig = significantNodes[m].size();
+      int *modLabel = &label[static_cast<size_t>(m)*Nboots];
+      if(Nsig == 0){
+        fill(modLabel,modLabel + Nboots,-1);
+        continue;
+      }
+      bootClusters.labels(significantNodes[m][0],modLabel);
+      for(int l=1;l<Nsig;l++){
+        bootClusters.labels(significantNodes[m][l],&nodeLabel[0]);
+        for(int k=0;k<Nboots;k++)
+          if(nodeLabel[k] != modLabel[k])
+            modLabel[k] = -1;
+      }
+    }
+  }
+
+  // Whole modules of every bootstrap as (bootstrap module, module), sorted so
+  // that modules clustered together are next to each other, and the position
+  // of the first module clustered together with each module
+  vector<pair<int,int> > order(static_cast<size_t>(Nboots)*M);
+  vector<int> Nwhole(Nboots);
+  vector<int> groupStart(static_cast<size_t>(M)*Nboots);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for(int k=0;k<Nboots;k++){
+    pair<int,int> *bootOrder = &order[static_cast<size_t>(k)*M];
+    int n = 0;
+    for(int m=0;m<M;m++){
+      int modNr = label[static_cast<size_t>(m)*Nboots + k];
+      if(modNr >= 0)
+        bootOrder[n++] = make_pair(modNr,m);
+    }
+    sort(bootOrder,bootOrder + n);
+    Nwhole[k] = n;
+    int start = 0;
+    for(int p=0;p<n;p++){
+      if(bootOrder[p].first != bootOrder[start].first)
+        start = p;
+      groupStart[static_cast<size_t>(bootOrder[p].second)*Nboots + k] = start;
+    }
+  }
+
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+  {
+    // One bitset over the bootstraps for every module met together with i
+    vector<Word> together(static_cast<size_t>(M)*Nwords);
+    vector<char> met(M,0);
+    vector<int> partners;
+
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+    for(int i=0;i<M;i++){
+
+      coexistCount[i] = vector<int>(Nboots,0);
+      partners.clear();
+      for(int k=0;k<Nboots;k++){
+        int modNr = label[static_cast<size_t>(i)*Nboots + k];
+        if(modNr < 0)
+          continue;
+        pair<int,int> *bootOrder = &order[static_cast<size_t>(k)*M];
+        int n = 0;
+        for(int p=groupStart[static_cast<size_t>(i)*Nboots + k];p<Nwhole[k] && bootOrder[p].first == modNr;p++){
+          int j = bootOrder[p].second;
+          if(j == i)
+            continue;
+          n++;
+          Word *bits = &together[static_cast<size_t>(j)*Nwords];
+          if(!met[j]){
+            met[j] = 1;
+            partners.push_back(j);
+            fill(bits,bits + Nwords,0ULL);
+          }
+          bits[k/64] |= 1ULL << (k%64);
+        }
+        coexistCount[i][k] = n;
+      }
+
+      // Equal counts keep the order of insertion, by decreasing module
+      sort(partners.begin(),partners.end(),greater<int>());
+      multimap<int,pair<int,vector<int> >,greater<int> > found;
+      for(unsigned int p=0;p<partners.size();p++){
+        int j = partners[p];
+        met[j] = 0;
+        Word *bits = &together[static_cast<size_t>(j)*Nwords];
+        int count = 0;
+        for(int w=0;w<Nwords;w++)
+          count += __builtin_popcountll(bits[w]);
+        vector<int> boots;
+        boots.reserve(count);
+        for(int w=0;w<Nwords;w++){
+          Word b = bits[w];
+          while(b != 0){
+            boots.push_back(64*w + __builtin_ctzll(b));
+            b &= b - 1;
+          }
+        }
+        found.insert(make_pair(count,make_pair(j,boots)));
+      }
+      coExist[i].swap(found);
+
+    }
+  }
+
+}
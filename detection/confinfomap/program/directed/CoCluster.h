@@ -0,0 +1,23 @@
+#ifndef COCLUSTER_H
+#define COCLUSTER_H
+
+#include <vector>
+#include <map>
+#include <functional>
+#include "BootClusterStore.h"
+using namespace std;
+
+// Co-clustering of the modules of the original network in the bootstrap
+// partitions. A module is whole in a bootstrap when all its significant
+// nodes are in one bootstrap module, and two modules are clustered together
+// when they are whole in the same bootstrap module. For every module i,
+// coexistCount[i][k] is the number of modules clustered together with it in
+// bootstrap k, and coExist[i] maps the number of bootstraps to (module, the
+// bootstraps) for every module that is clustered together with i at least
+// once, most often first and ties by decreasing module number.
+// The bootstraps in which two modules are together are collected as bitsets
+// and counted with popcounts. Modules are handled in parallel when built
+// with OpenMP (make OPENMP=1).
+void coClusterModules(int M,vector<vector<int> > &significantNodes,BootClusterStore &bootClusters,vector<vector<int> > &coexistCount,vector<multimap<int,pair<int,vector<int> >,greater<int> > > &coExist);
+
+#endif
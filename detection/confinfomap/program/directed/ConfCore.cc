@@ -0,0 +1,426 @@
+#include "ConfCore.h"
+#include <cmath>
+#include <algorithm>
+#include <cstring>
+
+// Confident nodes in the bootstrap modules of the members of one module.
+// The bootstrap modules of bootstrap k are numbered 0,1,... and module m is
+// entry base[k]+m of count, modSize and pos. The modules with confident nodes
+// form a max-heap by size in heap[base[k]],...,heap[base[k]+heapSize[k]-1],
+// ties by module number, and pos is the position of a module in the heap,
+// -1 when it has no confident nodes.
+// The bootstrap modules of member j are stored in row j of mod, bootstrap k
+// at byte offset[k] in 1, 2 or 4 bytes, as few as the largest bootstrap
+// module among the members needs, and are decoded one row at a time.
+class BootModules{
+ public:
+  BootModules(vector<int> &members,BootClusterStore &bootClusters);
+  bool empty(int k){ return heapSize[k] == 0; }
+  int top(int k){ return heap[base[k]]; }
+  int second(int k);
+  int countOf(int k,int m){ return count[base[k]+m]; }
+  double sizeOf(int k,int m){ return modSize[base[k]+m]; }
+  void add(int k,int m,double s);
+  void remove(int k,int m,double s);
+  // Bootstrap modules of member j in all bootstraps
+  void labels(int j,int *out){
+    const unsigned char *row = &mod[static_cast<size_t>(j)*rowSize];
+    for(int k=0;k<Nboots;k++)
+      out[k] = get(row + offset[k],width[k]);
+  }
+
+  int Nboots;
+
+ private:
+  bool larger(int k,int a,int b){
+    double sa = modSize[base[k]+a];
+    double sb = modSize[base[k]+b];
+    return sa > sb || (sa == sb && a < b);
+  }
+  void place(int k,int p,int m){
+    heap[base[k]+p] = m;
+    pos[base[k]+m] = p;
+  }
+  void siftUp(int k,int p);
+  void siftDown(int k,int p);
+  int get(const unsigned char *p,int w){
+    if(w == 1)
+      return p[0];
+    if(w == 2){
+      unsigned short label;
+      memcpy(&label,p,2);
+      return label;
+    }
+    int label;
+    memcpy(&label,p,4);
+    return label;
+  }
+  void set(unsigned char *p,int w,int label){
+    if(w == 1)
+      p[0] = static_cast<unsigned char>(label);
+    else if(w == 2){
+      unsigned short l = static_cast<unsigned short>(label);
+      memcpy(p,&l,2);
+    }
+    else
+      memcpy(p,&label,4);
+  }
+
+  vector<unsigned char> mod;
+  vector<int> width;
+  vector<int> offset;
+  int rowSize;
+  vector<int> base;
+  vector<int> count;
+  vector<double> modSize;
+  vector<int> heap;
+  vector<int> heapSize;
+  vector<int> pos;
+};
+
+BootModules::BootModules(vector<int> &members,BootClusterStore &bootClusters){
+
+  int N = members.size();
+  Nboots = bootClusters.Nboots;
+  base = vector<int>(Nboots+1,0);
+  vector<int> row(Nboots);
+
+  // Width of each bootstrap from the largest module among the members
+  vector<int> maxLabel(Nboots,0);
+  for(int j=0;j<N;j++){
+    bootClusters.labels(members[j],&row[0]);
+    for(int k=0;k<Nboots;k++)
+      if(row[k] > maxLabel[k])
+        maxLabel[k] = row[k];
+  }
+  width = vector<int>(Nboots);
+  offset = vector<int>(Nboots);
+  rowSize = 0;
+  for(int k=0;k<Nboots;k++){
+    width[k] = maxLabel[k] < 256 ? 1 : (maxLabel[k] < 65536 ? 2 : 4);
+    offset[k] = rowSize;
+    rowSize += width[k];
+  }
+  mod = vector<unsigned char>(static_cast<size_t>(N)*rowSize);
+  for(int j=0;j<N;j++){
+    bootClusters.labels(members[j],&row[0]);
+    unsigned char *p = &mod[static_cast<size_t>(j)*rowSize];
+    for(int k=0;k<Nboots;k++)
+      set(p + offset[k],width[k],row[k]);
+  }
+
+  // Renumber in place, one bootstrap at a time
+  vector<pair<int,int> > order(N);
+  for(int k=0;k<Nboots;k++){
+    for(int j=0;j<N;j++)
+      order[j] = make_pair(get(&mod[static_cast<size_t>(j)*rowSize + offset[k]],width[k]),j);
+    sort(order.begin(),order.end());
+    int modNr = 0;
+    for(int j=0;j<N;j++){
+      if(j > 0 && order[j].first != order[j-1].first)
+        modNr++;
+      set(&mod[static_cast<size_t>(order[j].second)*rowSize + offset[k]],width[k],modNr);
+    }
+    base[k+1] = base[k] + modNr + 1;
+  }
+
+  int Nmod = base[Nboots];
+  count = vector<int>(Nmod,0);
+  modSize = vector<double>(Nmod,0.0);
+  heap = vector<int>(Nmod);
+  heapSize = vector<int>(Nboots,0);
+  pos = vector<int>(Nmod,-1);
+
+}
+
+// Second largest module of bootstrap k, -1 if there is none
+int BootModules::second(int k){
+
+  if(heapSize[k] < 2)
+    return -1;
+  int m = heap[base[k]+1];
+  if(heapSize[k] > 2 && larger(k,heap[base[k]+2],m))
+    m = heap[base[k]+2];
+  return m;
+
+}
+
+void BootModules::siftUp(int k,int p){
+
+  int m = heap[base[k]+p];
+  while(p > 0){
+    int parent = (p-1)/2;
+    if(!larger(k,m,heap[base[k]+parent]))
+      break;
+    place(k,p,heap[base[k]+parent]);
+    p = parent;
+  }
+  place(k,p,m);
+
+}
+
+void BootModules::siftDown(int k,int p){
+
+  int m = heap[base[k]+p];
+  int n = heapSize[k];
+  while(2*p+1 < n){
+    int child = 2*p+1;
+    if(child+1 < n && larger(k,heap[base[k]+child+1],heap[base[k]+child]))
+      child++;
+    if(!larger(k,heap[base[k]+child],m))
+      break;
+    place(k,p,heap[base[k]+child]);
+    p = child;
+  }
+  place(k,p,m);
+
+}
+
+// Add a confident node of size s to module m of bootstrap k
+void BootModules::add(int k,int m,double s){
+
+  int i = base[k]+m;
+  count[i]++;
+  modSize[i] += s;
+  if(pos[i] < 0){
+    place(k,heapSize[k],m);
+    heapSize[k]++;
+  }
+  siftUp(k,pos[i]);
+
+}
+
+// Remove a confident node of size s from module m of bootstrap k
+void BootModules::remove(int k,int m,double s){
+
+  int i = base[k]+m;
+  int p = pos[i];
+  count[i]--;
+  if(count[i] == 0){ // Remove last confident node from module
+    modSize[i] = 0.0;
+    pos[i] = -1;
+    heapSize[k]--;
+    if(p < heapSize[k]){
+      int last = heap[base[k]+heapSize[k]];
+      place(k,p,last);
+      siftDown(k,p);
+      siftUp(k,pos[base[k]+last]);
+    }
+  }
+  else{
+    modSize[i] -= s;
+    siftDown(k,p);
+  }
+
+}
+
+// Score of a bootstrap, ranked from the worst with ties in bootstrap order
+class BootScore{
+ public:
+  double rank;
+  int penalty;
+  int boot;
+  bool operator<(const BootScore &b) const {
+    return rank < b.rank || (rank == b.rank && boot < b.boot);
+  }
+};
+
+void findModuleCore(vector<int> &members,vector<double> &size,double moduleSize,BootClusterStore &bootClusters,int Nremove,Random &R,vector<bool> &maxConfState,double &maxConfSize,int &maxConfN){
+
+  int N = members.size();
+  int Nboots = bootClusters.Nboots;
+  if(Nremove > Nboots)
+    Nremove = Nboots;
+
+  maxConfState = vector<bool>(N,false);
+  maxConfSize = 0.0;
+  maxConfN = 0;
+  if(N == 1){
+    maxConfState[0] = true;
+    maxConfSize = moduleSize;
+    maxConfN = 1;
+    return;
+  }
+
+  vector<bool> confState = vector<bool>(N);
+  double maxScore = -1.0;
+  double confSize = 0.0;
+  int confN = 0;
+  double score = 0.0;
+  int penalty = 0;
+
+  double pW = 10.0*moduleSize;
+
+  BootModules boot(members,bootClusters);
+  vector<BootScore> scoreRank(Nboots);
+  vector<int> modRow(Nboots);
+  int *mod = &modRow[0];
+
+  // Randomized start
+  for(int j=0;j<N;j++){
+    if(R.randInt() << 31){
+      confState[j] = true;
+      confSize += size[members[j]];
+      confN++;
+      boot.labels(j,mod);
+      for(int k=0;k<Nboots;k++)
+        boot.add(k,mod[k],size[members[j]]);
+    }
+    else
+      confState[j] = false;
+  }
+
+  // Calculate penalty
+  for(int k=0;k<Nboots;k++){
+    double tmpScore = 0.0;
+    int tmpPenalty = 0;
+    if(!boot.empty(k)){
+      int top = boot.top(k);
+      tmpScore = boot.sizeOf(k,top);
+      tmpPenalty = confN - boot.countOf(k,top); //penalty is the number of nodes not in biggest field
+    }
+    scoreRank[k].rank = tmpScore-pW*tmpPenalty;
+    scoreRank[k].penalty = tmpPenalty;
+    scoreRank[k].boot = k;
+    score += tmpScore;
+    penalty += tmpPenalty;
+  }
+
+  // Remove worst results
+  partial_sort(scoreRank.begin(),scoreRank.begin()+Nremove,scoreRank.end());
+  for(int j=0;j<Nremove;j++){
+    int bootNr = scoreRank[j].boot;
+    if(!boot.empty(bootNr)){
+      score -= boot.sizeOf(bootNr,boot.top(bootNr));
+      penalty -= scoreRank[j].penalty;
+    }
+  }
+
+  //Monte Carlo to maximize confident size
+  int Niter = N;
+  if(Niter < 100)
+    Niter = 100;
+  int switches = 0;
+  bool search = true;
+  while(search){
+
+    double T = 1.0;
+
+    do{
+
+      switches = 0;
+      for(int j=0;j<Niter;j++){
+
+        double newConfSize = confSize;
+        int newConfN = confN;
+        double newScore = 0.0;
+        int newPenalty = 0;
+
+        int flip = R.randInt(N-1);
+        int nodeNr = members[flip];
+        boot.labels(flip,mod);
+
+        if(confState[flip]){ // Remove one node from confident subset
+          newConfSize -= size[nodeNr];
+          newConfN--;
+          for(int k=0;k<Nboots;k++){
+            int top = boot.top(k);
+            double tmpScore = boot.sizeOf(k,top);
+            int tmpPenalty = newConfN - boot.countOf(k,top);
+            if(mod[k] == top){
+              tmpScore -= size[nodeNr];
+              tmpPenalty = newConfN - (boot.countOf(k,top)-1);
+              int second = boot.second(k);
+              if(second >= 0 && boot.sizeOf(k,second) > tmpScore){ // Check if second in ranking is larger
+                tmpScore = boot.sizeOf(k,second);
+                tmpPenalty = newConfN - boot.countOf(k,second);
+              }
+            }
+            scoreRank[k].rank = tmpScore-pW*tmpPenalty;
+            scoreRank[k].penalty = tmpPenalty;
+            scoreRank[k].boot = k;
+            newScore += tmpScore;
+            newPenalty += tmpPenalty;
+          }
+        }
+        else{ // Add one node to confident subset
+          newConfSize += size[nodeNr];
+          newConfN++;
+          for(int k=0;k<Nboots;k++){
+            int modNr = mod[k];
+            double tmpScore = 0.0;
+            int tmpPenalty = 0;
+            if(boot.empty(k)){ // No nodes in confident subset
+              tmpScore = size[nodeNr];
+              tmpPenalty = 0;
+            }
+            else{
+              int top = boot.top(k);
+              if(modNr == top){
+                tmpScore = boot.sizeOf(k,top) + size[nodeNr];
+                tmpPenalty = newConfN - (boot.countOf(k,top)+1);
+              }
+              else if(boot.sizeOf(k,modNr) + size[nodeNr] > boot.sizeOf(k,top)){
+                tmpScore = boot.sizeOf(k,modNr) + size[nodeNr];
+                tmpPenalty = newConfN - (boot.countOf(k,modNr)+1);
+              }
+              else{
+                tmpScore = boot.sizeOf(k,top);
+                tmpPenalty = newConfN - boot.countOf(k,top);
+              }
+            }
+            scoreRank[k].rank = tmpScore-pW*tmpPenalty;
+            scoreRank[k].penalty = tmpPenalty;
+            scoreRank[k].boot = k;
+            newScore += tmpScore;
+            newPenalty += tmpPenalty;
+          }
+        }
+
+        // Remove worst results
+        partial_sort(scoreRank.begin(),scoreRank.begin()+Nremove,scoreRank.end());
+        for(int r=0;r<Nremove;r++){
+          int bootNr = scoreRank[r].boot;
+          if(!boot.empty(bootNr)){
+            newScore -= boot.sizeOf(bootNr,boot.top(bootNr));
+            newPenalty -= scoreRank[r].penalty;
+          }
+        }
+
+        if(exp(((newScore-pW*newPenalty)-(score-pW*penalty))/T) > R.rand()){
+
+          // Update data structures
+          if(confState[flip]){ // Remove one node from confident subset
+            for(int k=0;k<Nboots;k++)
+              boot.remove(k,mod[k],size[nodeNr]);
+          }
+          else{ // Add one node to confident subset
+            for(int k=0;k<Nboots;k++)
+              boot.add(k,mod[k],size[nodeNr]);
+          }
+
+          confSize = newConfSize;
+          confN = newConfN;
+          confState[flip] = !confState[flip];
+          penalty = newPenalty;
+          score = newScore;
+          switches++;
+        }
+
+        if(penalty == 0 && score > maxScore){
+          maxConfState = confState;
+          maxScore = score;
+          maxConfSize = confSize;
+          maxConfN = confN;
+        }
+
+      }
+      T *= 0.99;
+    } while(switches > 0);
+
+    if(maxScore > 0.0)
+      search = false;
+
+  }
+
+}
@@ -0,0 +1,23 @@
+#ifndef CONFCORE_H
+#define CONFCORE_H
+
+#include <vector>
+#include "Random.h"
+#include "BootClusterStore.h"
+using namespace std;
+
+#define CONFCORE_LARGE 16777216 // Member-bootstrap pairs of a module searched alone
+
+// Monte Carlo search for the confident core of one module: the subset of its
+// members with the largest total size that is found in a single bootstrap
+// module in all but the Nremove worst bootstraps. members are the nodes of the
+// module and size[node] their sizes. The bootstrap modules of the members are
+// renumbered within each bootstrap and kept in 1, 2 or 4 bytes per member and
+// bootstrap, and their confident sizes are kept in flat arrays with one
+// indexed max-heap per bootstrap, so the largest and second largest module of
+// a bootstrap are read in constant time and a flip updates each bootstrap in
+// logarithmic time. The search only draws from R, so modules can be searched
+// in parallel with one stream each.
+void findModuleCore(vector<int> &members,vector<double> &size,double moduleSize,BootClusterStore &bootClusters,int Nremove,Random &R,vector<bool> &maxConfState,double &maxConfSize,int &maxConfN);
+
+#endif
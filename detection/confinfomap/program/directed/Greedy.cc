@@ -1,11 +1,18 @@
 #include "Greedy.h"
+#include "PerfCounters.h"
 #define plogp( x ) ( (x) > 0.0 ? (x)*log(x) : 0.0 )
 
+LinkOrder GreedyBase::linkOrder = LINKS_SHUFFLE;
+bool GreedyBase::activeSet = false;
+
+// Links ahead of the current one whose module is fetched into cache
+static const int PREFETCH_AHEAD = 8;
+
 Greedy::~Greedy(){	
   vector<int>().swap(modSnode);
 }
 
-Greedy::Greedy(MTRand *RR,int nnode,Node **ah,int nmember){
+Greedy::Greedy(Random *RR,int nnode,Node **ah,int nmember){
   
   R = RR;
   Nnode = nnode;  
@@ -17,212 +24,298 @@ Greedy::Greedy(MTRand *RR,int nnode,Node **ah,int nmember){
   beta = 1.0-alpha; // probability to take normal step
   
   Ndanglings = 0;
+  offset = 1;
+  queueStamp = 0;
   
 }
 
 void Greedy::move(bool &moved){
   
+  PerfRegion region(PERF_MOVE);
+  
   // Generate random enumeration of nodes
   vector<int> randomOrder(Nnode);
   for(int i=0;i<Nnode;i++)
     randomOrder[i] = i;
-  for(int i=0;i<Nnode-1;i++){
-    int randPos = i + R->randInt(Nnode-i-1);
-    int tmp = randomOrder[i];
-    randomOrder[i] = randomOrder[randPos];
-    randomOrder[randPos] = tmp;
-  }
-  
-  unsigned int offset = 1;    
-  vector<unsigned int> redirect(Nnode,0);
-  vector<pair<int,pair<double,double> > > flowNtoM(Nnode);
+  R->shuffle(&randomOrder[0],Nnode);
   
+  scratch();
   for(int k=0;k<Nnode;k++){
-    
     // Pick nodes in random order
-    int flip = randomOrder[k]; 
-    int oldM = node[flip]->index; 
-    
-    // Reset offset when int overflows
-    if(offset > INT_MAX){ 
-      for(int j=0;j<Nnode;j++)
-        redirect[j] = 0;
-      offset = 1;
-    }  
-    
-    // Size of vector with module links
-    int NmodLinks = 0;
-    
-    // For all outLinks
-    int NoutLinks = node[flip]->outLinks.size();
-    if(NoutLinks == 0){ //dangling node, add node to calculate flow below
-      redirect[oldM] = offset + NmodLinks;
-      flowNtoM[NmodLinks].first = oldM;
-      flowNtoM[NmodLinks].second.first = 0.0;
-      flowNtoM[NmodLinks].second.second = 0.0;
-      NmodLinks++;
-    }
-    else{
-      for(int j=0; j<NoutLinks; j++){
-        int nb_M = node[node[flip]->outLinks[j].first]->index;
-        double nb_flow = node[flip]->outLinks[j].second;
-        if(redirect[nb_M] >= offset){
-          flowNtoM[redirect[nb_M] - offset].second.first += nb_flow;
+    if(moveNode(randomOrder[k]))
+      moved = true;
+  }
+  
+}
+
+void Greedy::moveSet(vector<int> &active,bool &moved){
+  
+  PerfRegion region(PERF_MOVE);
+  
+  int Nactive = active.size();
+  if(Nactive > 1)
+    R->shuffle(&active[0],Nactive);
+  
+  scratch();
+  if(++queueStamp == 0){ 
+    for(int i=0;i<Nnode;i++)
+      queued[i] = 0;
+    queueStamp = 1;
+  }
+  
+  // Neighbors of the nodes that change module are tried in the next sweep
+  vector<int> next;
+  for(int k=0;k<Nactive;k++){
+    int flip = active[k];
+    if(moveNode(flip)){
+      moved = true;
+      int NoutLinks = node[flip]->outLinks.size();
+      for(int j=0;j<NoutLinks;j++){
+        int nb = node[flip]->outLinks[j].first;
+        if(queued[nb] != queueStamp){
+          queued[nb] = queueStamp;
+          next.push_back(nb);
         }
-        else{
-          redirect[nb_M] = offset + NmodLinks;
-          flowNtoM[NmodLinks].first = nb_M;
-          flowNtoM[NmodLinks].second.first = nb_flow;
-          flowNtoM[NmodLinks].second.second = 0.0;
-          NmodLinks++;
+      }
+      int NinLinks = node[flip]->inLinks.size();
+      for(int j=0;j<NinLinks;j++){
+        int nb = node[flip]->inLinks[j].first;
+        if(queued[nb] != queueStamp){
+          queued[nb] = queueStamp;
+          next.push_back(nb);
         }
       }
     }
-    
-    // For all inLinks
-    int NinLinks = node[flip]->inLinks.size();
-    for(int j=0; j<NinLinks; j++){
-      int nb_M = node[node[flip]->inLinks[j].first]->index;
-      double nb_flow = node[flip]->inLinks[j].second;
-      
+  }
+  active.swap(next);
+  
+}
+
+void Greedy::scratch(void){
+  
+  if(static_cast<int>(redirect.size()) < Nnode){
+    vector<unsigned int>(Nnode,0).swap(redirect);
+    vector<pair<int,pair<double,double> > >(Nnode).swap(flowNtoM);
+    vector<unsigned int>(Nnode,0).swap(queued);
+    offset = 1;
+  }
+  
+}
+
+// Fetch the module of the neighbor PREFETCH_AHEAD links on into cache, and
+// half as far on, where that module is in cache, its entries in redirect and
+// the module arrays read for every candidate move
+void Greedy::prefetchModule(vector<pair<int,double> > &links,int j,int Nlinks){
+  
+  if(j + PREFETCH_AHEAD < Nlinks)
+    __builtin_prefetch(&node_index[links[j+PREFETCH_AHEAD].first]);
+  if(j + PREFETCH_AHEAD/2 < Nlinks){
+    int ahead_M = node_index[links[j+PREFETCH_AHEAD/2].first];
+    __builtin_prefetch(&redirect[ahead_M]);
+    __builtin_prefetch(&mod_exit[ahead_M]);
+    __builtin_prefetch(&mod_size[ahead_M]);
+  }
+  
+}
+
+bool Greedy::moveNode(int flip){
+  
+  int oldM = node_index[flip];
+  
+  // Reset offset when int overflows
+  if(offset > INT_MAX){ 
+    for(unsigned int j=0;j<redirect.size();j++)
+      redirect[j] = 0;
+    offset = 1;
+  }  
+  
+  // Size of vector with module links
+  int NmodLinks = 0;
+  
+  // For all outLinks
+  int NoutLinks = node[flip]->outLinks.size();
+  if(NoutLinks == 0){ //dangling node, add node to calculate flow below
+    redirect[oldM] = offset + NmodLinks;
+    flowNtoM[NmodLinks].first = oldM;
+    flowNtoM[NmodLinks].second.first = 0.0;
+    flowNtoM[NmodLinks].second.second = 0.0;
+    NmodLinks++;
+  }
+  else{
+    vector<pair<int,double> > &outLinks = node[flip]->outLinks;
+    for(int j=0; j<NoutLinks; j++){
+      prefetchModule(outLinks,j,NoutLinks);
+      int nb_M = node_index[outLinks[j].first];
+      double nb_flow = outLinks[j].second;
       if(redirect[nb_M] >= offset){
-        flowNtoM[redirect[nb_M] - offset].second.second += nb_flow;
+        flowNtoM[redirect[nb_M] - offset].second.first += nb_flow;
       }
       else{
         redirect[nb_M] = offset + NmodLinks;
         flowNtoM[NmodLinks].first = nb_M;
-        flowNtoM[NmodLinks].second.first = 0.0;
-        flowNtoM[NmodLinks].second.second = nb_flow;
+        flowNtoM[NmodLinks].second.first = nb_flow;
+        flowNtoM[NmodLinks].second.second = 0.0;
         NmodLinks++;
       }
     }
+  }
+  
+  // For all inLinks
+  vector<pair<int,double> > &inLinks = node[flip]->inLinks;
+  int NinLinks = inLinks.size();
+  for(int j=0; j<NinLinks; j++){
+    prefetchModule(inLinks,j,NinLinks);
+    int nb_M = node_index[inLinks[j].first];
+    double nb_flow = inLinks[j].second;
     
-    // For teleportation and dangling nodes
-    for(int j=0;j<NmodLinks;j++){
-      int newM = flowNtoM[j].first;
-      if(newM == oldM){
-        flowNtoM[j].second.first += (alpha*node[flip]->size + beta*node[flip]->danglingSize)*(mod_teleportWeight[oldM]-node[flip]->teleportWeight);
-        flowNtoM[j].second.second += (alpha*(mod_size[oldM]-node[flip]->size) + beta*(mod_danglingSize[oldM]-node[flip]->danglingSize))*node[flip]->teleportWeight;
-      }
-      else{
-        flowNtoM[j].second.first += (alpha*node[flip]->size + beta*node[flip]->danglingSize)*mod_teleportWeight[newM];
-        flowNtoM[j].second.second += (alpha*mod_size[newM] + beta*mod_danglingSize[newM])*node[flip]->teleportWeight;
-      }
+    if(redirect[nb_M] >= offset){
+      flowNtoM[redirect[nb_M] - offset].second.second += nb_flow;
     }
-    
-    // Calculate flow to/from own module (default value if no link to own module)
-    double outFlowOldM = (alpha*node[flip]->size + beta*node[flip]->danglingSize)*(mod_teleportWeight[oldM]-node[flip]->teleportWeight);
-    double inFlowOldM = (alpha*(mod_size[oldM]-node[flip]->size) + beta*(mod_danglingSize[oldM]-node[flip]->danglingSize))*node[flip]->teleportWeight;
-    if(redirect[oldM] >= offset){
-      outFlowOldM = flowNtoM[redirect[oldM] - offset].second.first;
-      inFlowOldM = flowNtoM[redirect[oldM] - offset].second.second;   
+    else{
+      redirect[nb_M] = offset + NmodLinks;
+      flowNtoM[NmodLinks].first = nb_M;
+      flowNtoM[NmodLinks].second.first = 0.0;
+      flowNtoM[NmodLinks].second.second = nb_flow;
+      NmodLinks++;
     }
-    
-    // Option to move to empty module (if node not already alone)
-    if(mod_members[oldM] > static_cast<int>(node[flip]->members.size())){
-      if(Nempty > 0){
-        flowNtoM[NmodLinks].first = mod_empty[Nempty-1];
-        flowNtoM[NmodLinks].second.first = 0.0;
-        flowNtoM[NmodLinks].second.second = 0.0;
-        NmodLinks++;
-      }
+  }
+  
+  double flip_exit = node_exit[flip];
+  double flip_size = node_size[flip];
+  double flip_danglingSize = node_danglingSize[flip];
+  double flip_teleportWeight = node_teleportWeight[flip];
+  
+  // For teleportation and dangling nodes
+  for(int j=0;j<NmodLinks;j++){
+    int newM = flowNtoM[j].first;
+    if(newM == oldM){
+      flowNtoM[j].second.first += (alpha*flip_size + beta*flip_danglingSize)*(mod_teleportWeight[oldM]-flip_teleportWeight);
+      flowNtoM[j].second.second += (alpha*(mod_size[oldM]-flip_size) + beta*(mod_danglingSize[oldM]-flip_danglingSize))*flip_teleportWeight;
     }
-    
-    // Randomize link order for optimized search 
-    for(int j=0;j<NmodLinks-1;j++){
-      int randPos = j + R->randInt(NmodLinks-j-1);
-      int tmp_M = flowNtoM[j].first;
-      double tmp_outFlow = flowNtoM[j].second.first;
-      double tmp_inFlow = flowNtoM[j].second.second;
-      flowNtoM[j].first = flowNtoM[randPos].first;
-      flowNtoM[j].second.first = flowNtoM[randPos].second.first;
-      flowNtoM[j].second.second = flowNtoM[randPos].second.second;
-      flowNtoM[randPos].first = tmp_M;
-      flowNtoM[randPos].second.first = tmp_outFlow;
-      flowNtoM[randPos].second.second = tmp_inFlow;
+    else{
+      flowNtoM[j].second.first += (alpha*flip_size + beta*flip_danglingSize)*mod_teleportWeight[newM];
+      flowNtoM[j].second.second += (alpha*mod_size[newM] + beta*mod_danglingSize[newM])*flip_teleportWeight;
     }
-    
-    int bestM = oldM;
-    double best_outFlow = 0.0;
-    double best_inFlow = 0.0;
-    double best_delta = 0.0;
-    
-    // Find the move that minimizes the description length
-    for (int j=0; j<NmodLinks; j++) {
-      
-      int newM = flowNtoM[j].first;
-      double outFlowNewM = flowNtoM[j].second.first;
-      double inFlowNewM = flowNtoM[j].second.second;
-      
-      if(newM != oldM){
-        
-        double delta_exit = plogp(exitFlow + outFlowOldM + inFlowOldM - outFlowNewM - inFlowNewM) - exit;
-        
-        double delta_exit_log_exit = - plogp(mod_exit[oldM]) - plogp(mod_exit[newM]) \
-        + plogp(mod_exit[oldM] - node[flip]->exit + outFlowOldM + inFlowOldM) + plogp(mod_exit[newM] + node[flip]->exit - outFlowNewM - inFlowNewM);
-        
-        double delta_size_log_size = - plogp(mod_exit[oldM] + mod_size[oldM]) - plogp(mod_exit[newM] + mod_size[newM]) \
-        + plogp(mod_exit[oldM] + mod_size[oldM] - node[flip]->exit - node[flip]->size + outFlowOldM + inFlowOldM) \
-        + plogp(mod_exit[newM] + mod_size[newM] + node[flip]->exit + node[flip]->size - outFlowNewM - inFlowNewM);
-        
-        double deltaL = delta_exit - 2.0*delta_exit_log_exit + delta_size_log_size;
-        
-        if(deltaL < best_delta){
-          bestM = newM;
-          best_outFlow = outFlowNewM;
-          best_inFlow = inFlowNewM;
-          best_delta = deltaL;  
-        }	  
-      }
+  }
+  
+  // Calculate flow to/from own module (default value if no link to own module)
+  double outFlowOldM = (alpha*flip_size + beta*flip_danglingSize)*(mod_teleportWeight[oldM]-flip_teleportWeight);
+  double inFlowOldM = (alpha*(mod_size[oldM]-flip_size) + beta*(mod_danglingSize[oldM]-flip_danglingSize))*flip_teleportWeight;
+  if(redirect[oldM] >= offset){
+    outFlowOldM = flowNtoM[redirect[oldM] - offset].second.first;
+    inFlowOldM = flowNtoM[redirect[oldM] - offset].second.second;   
+  }
+  
+  // Option to move to empty module (if node not already alone)
+  if(mod_members[oldM] > node_members[flip]){
+    if(Nempty > 0){
+      flowNtoM[NmodLinks].first = mod_empty[Nempty-1];
+      flowNtoM[NmodLinks].second.first = 0.0;
+      flowNtoM[NmodLinks].second.second = 0.0;
+      NmodLinks++;
     }
+  }
+  
+  // Randomize link order for optimized search
+  int start = 0;
+  int Nties = 1;
+  if(linkOrder == LINKS_SHUFFLE)
+    R->shuffle(&flowNtoM[0],NmodLinks);
+  else if(linkOrder == LINKS_ROTATE && NmodLinks > 1)
+    start = R->randBelow(NmodLinks);
+  
+  int bestM = oldM;
+  double best_outFlow = 0.0;
+  double best_inFlow = 0.0;
+  double best_delta = 0.0;
+  
+  // Find the move that minimizes the description length
+  for (int l=0; l<NmodLinks; l++) {
+    int j = l + start;
+    if(j >= NmodLinks)
+      j -= NmodLinks;
+    
+    int newM = flowNtoM[j].first;
+    double outFlowNewM = flowNtoM[j].second.first;
+    double inFlowNewM = flowNtoM[j].second.second;
     
-    // Make best possible move
-    if(bestM != oldM){
-      
-      //Update empty module vector
-      if(mod_members[bestM] == 0){
-        Nempty--;
-      }
-      if(mod_members[oldM] == static_cast<int>(node[flip]->members.size())){
-        mod_empty[Nempty] = oldM;
-        Nempty++;
-      }
-      
-      exitFlow -= mod_exit[oldM] + mod_exit[bestM];
-      exit_log_exit -= plogp(mod_exit[oldM]) + plogp(mod_exit[bestM]);
-      size_log_size -= plogp(mod_exit[oldM] + mod_size[oldM]) + plogp(mod_exit[bestM] + mod_size[bestM]); 
-      
-      mod_exit[oldM] -= node[flip]->exit - outFlowOldM - inFlowOldM;
-      mod_size[oldM] -= node[flip]->size;
-      mod_danglingSize[oldM] -= node[flip]->danglingSize;
-      mod_teleportWeight[oldM] -= node[flip]->teleportWeight;
-      mod_members[oldM] -= node[flip]->members.size();
-      mod_exit[bestM] += node[flip]->exit - best_outFlow - best_inFlow;
-      mod_size[bestM] += node[flip]->size;
-      mod_danglingSize[bestM] += node[flip]->danglingSize;
-      mod_teleportWeight[bestM] += node[flip]->teleportWeight;
-      mod_members[bestM] += node[flip]->members.size();
-      
-      exitFlow += mod_exit[oldM] + mod_exit[bestM];
+    if(newM != oldM){
       
-      // Update terms in map equation
+      double delta_exit = plogp(exitFlow + outFlowOldM + inFlowOldM - outFlowNewM - inFlowNewM) - exit;
       
-      exit_log_exit += plogp(mod_exit[oldM]) + plogp(mod_exit[bestM]);
-      size_log_size += plogp(mod_exit[oldM] + mod_size[oldM]) + plogp(mod_exit[bestM] + mod_size[bestM]); 
-      exit = plogp(exitFlow);
+      double delta_exit_log_exit = - plogp(mod_exit[oldM]) - plogp(mod_exit[newM]) \
+      + plogp(mod_exit[oldM] - flip_exit + outFlowOldM + inFlowOldM) + plogp(mod_exit[newM] + flip_exit - outFlowNewM - inFlowNewM);
       
-      // Update code length
+      double delta_size_log_size = - plogp(mod_exit[oldM] + mod_size[oldM]) - plogp(mod_exit[newM] + mod_size[newM]) \
+      + plogp(mod_exit[oldM] + mod_size[oldM] - flip_exit - flip_size + outFlowOldM + inFlowOldM) \
+      + plogp(mod_exit[newM] + mod_size[newM] + flip_exit + flip_size - outFlowNewM - inFlowNewM);
       
-      codeLength = exit - 2.0*exit_log_exit + size_log_size - nodeSize_log_nodeSize;
+      double deltaL = delta_exit - 2.0*delta_exit_log_exit + delta_size_log_size;
       
-      node[flip]->index = bestM;
-      moved = true;
+      bool better = deltaL < best_delta;
+      if(linkOrder == LINKS_TIEBREAK){
+        // Pick uniformly among equally good moves
+        if(better)
+          Nties = 1;
+        else if(deltaL == best_delta && bestM != oldM)
+          better = (R->randBelow(++Nties) == 0);
+      }
+      if(better){
+        bestM = newM;
+        best_outFlow = outFlowNewM;
+        best_inFlow = inFlowNewM;
+        best_delta = deltaL;  
+      }	  
+    }
+  }
+  
+  // Make best possible move
+  if(bestM != oldM){
+    
+    //Update empty module vector
+    if(mod_members[bestM] == 0){
+      Nempty--;
     }
+    if(mod_members[oldM] == node_members[flip]){
+      mod_empty[Nempty] = oldM;
+      Nempty++;
+    }
+    
+    exitFlow -= mod_exit[oldM] + mod_exit[bestM];
+    exit_log_exit -= plogp(mod_exit[oldM]) + plogp(mod_exit[bestM]);
+    size_log_size -= plogp(mod_exit[oldM] + mod_size[oldM]) + plogp(mod_exit[bestM] + mod_size[bestM]); 
+    
+    mod_exit[oldM] -= flip_exit - outFlowOldM - inFlowOldM;
+    mod_size[oldM] -= flip_size;
+    mod_danglingSize[oldM] -= flip_danglingSize;
+    mod_teleportWeight[oldM] -= flip_teleportWeight;
+    mod_members[oldM] -= node_members[flip];
+    mod_exit[bestM] += flip_exit - best_outFlow - best_inFlow;
+    mod_size[bestM] += flip_size;
+    mod_danglingSize[bestM] += flip_danglingSize;
+    mod_teleportWeight[bestM] += flip_teleportWeight;
+    mod_members[bestM] += node_members[flip];
+    
+    exitFlow += mod_exit[oldM] + mod_exit[bestM];
+    
+    // Update terms in map equation
+    
+    exit_log_exit += plogp(mod_exit[oldM]) + plogp(mod_exit[bestM]);
+    size_log_size += plogp(mod_exit[oldM] + mod_size[oldM]) + plogp(mod_exit[bestM] + mod_size[bestM]); 
+    exit = plogp(exitFlow);
+    
+    // Update code length
     
-    offset += Nnode;
+    codeLength = exit - 2.0*exit_log_exit + size_log_size - nodeSize_log_nodeSize;
     
+    node[flip]->index = bestM;
+    node_index[flip] = bestM;
   }
   
+  offset += Nnode;
+  
+  return bestM != oldM;
+  
 }
 
 void Greedy::initiate(void){
@@ -325,16 +418,16 @@ void Greedy::tune(void){
 	
   // Update all values except contribution from teleportation
   for(int i=0;i<Nnode;i++){
-    int i_M = node[i]->index;
+    int i_M = node_index[i];
     int Nlinks = node[i]->outLinks.size();
-    mod_size[i_M] += node[i]->size;
-    mod_danglingSize[i_M] += node[i]->danglingSize;
-    mod_teleportWeight[i_M] += node[i]->teleportWeight;
+    mod_size[i_M] += node_size[i];
+    mod_danglingSize[i_M] += node_danglingSize[i];
+    mod_teleportWeight[i_M] += node_teleportWeight[i];
     mod_members[i_M]++;
     for(int j=0;j<Nlinks;j++){
       int nb = node[i]->outLinks[j].first;
       double nb_w = node[i]->outLinks[j].second;
-      int nb_M = node[nb]->index;
+      int nb_M = node_index[nb];
       if(i_M != nb_M)
         mod_exit[i_M] += nb_w;
     }
@@ -368,6 +461,13 @@ void Greedy::calibrate(void){
   vector<double>(Nmod).swap(mod_teleportWeight);
   vector<int>(Nmod).swap(mod_members);
   
+  vector<int>(Nmod).swap(node_index);
+  vector<double>(Nmod).swap(node_exit);
+  vector<double>(Nmod).swap(node_size);
+  vector<double>(Nmod).swap(node_danglingSize);
+  vector<double>(Nmod).swap(node_teleportWeight);
+  vector<int>(Nmod).swap(node_members);
+  
   exit_log_exit = 0.0;
   size_log_size = 0.0;
   exitFlow = 0.0;
@@ -384,6 +484,13 @@ void Greedy::calibrate(void){
     mod_teleportWeight[i] = node[i]->teleportWeight;
     mod_members[i] = node[i]->members.size();
     node[i]->index = i;
+    
+    node_index[i] = i;
+    node_exit[i] = node[i]->exit;
+    node_size[i] = node[i]->size;
+    node_danglingSize[i] = node[i]->danglingSize;
+    node_teleportWeight[i] = node[i]->teleportWeight;
+    node_members[i] = node[i]->members.size();
   }
   
   exit = plogp(exitFlow);
@@ -426,6 +533,8 @@ void Greedy::prepare(bool sort){
 
 void Greedy::level(Node ***node_tmp, bool sort){
   
+  PerfRegion region(PERF_LEVEL);
+  
   prepare(sort);
   
   //Node ***ntmp = node_tmp;
@@ -534,15 +643,15 @@ void Greedy::determMove(vector<int> &moveTo){
     
     if(newM != oldM){
       
-      double outFlowOldM = (alpha*node[i]->size + beta*node[i]->danglingSize)*(mod_teleportWeight[oldM]-node[i]->teleportWeight);
-      double inFlowOldM = (alpha*(mod_size[oldM]-node[i]->size) + beta*(mod_danglingSize[oldM]-node[i]->danglingSize))*node[i]->teleportWeight;
-      double outFlowNewM = (alpha*node[i]->size + beta*node[i]->danglingSize)*mod_teleportWeight[newM];
-      double inFlowNewM = (alpha*mod_size[newM] + beta*mod_danglingSize[newM])*node[i]->teleportWeight;
+      double outFlowOldM = (alpha*node_size[i] + beta*node_danglingSize[i])*(mod_teleportWeight[oldM]-node_teleportWeight[i]);
+      double inFlowOldM = (alpha*(mod_size[oldM]-node_size[i]) + beta*(mod_danglingSize[oldM]-node_danglingSize[i]))*node_teleportWeight[i];
+      double outFlowNewM = (alpha*node_size[i] + beta*node_danglingSize[i])*mod_teleportWeight[newM];
+      double inFlowNewM = (alpha*mod_size[newM] + beta*mod_danglingSize[newM])*node_teleportWeight[i];
       
       // For all outLinks
       int NoutLinks = node[i]->outLinks.size();
       for(int j=0; j<NoutLinks; j++){
-        int nb_M = node[node[i]->outLinks[j].first]->index;
+        int nb_M = node_index[node[i]->outLinks[j].first];
         double nb_flow = node[i]->outLinks[j].second;
         if(nb_M == oldM){
           outFlowOldM += nb_flow; 
@@ -555,7 +664,7 @@ void Greedy::determMove(vector<int> &moveTo){
       // For all inLinks
       int NinLinks = node[i]->inLinks.size();
       for(int j=0; j<NinLinks; j++){
-        int nb_M = node[node[i]->inLinks[j].first]->index;
+        int nb_M = node_index[node[i]->inLinks[j].first];
         double nb_flow = node[i]->inLinks[j].second;
         if(nb_M == oldM){
           inFlowOldM += nb_flow; 
@@ -569,7 +678,7 @@ void Greedy::determMove(vector<int> &moveTo){
       if(mod_members[newM] == 0){
         Nempty--;
       }
-      if(mod_members[oldM] == static_cast<int>(node[i]->members.size())){
+      if(mod_members[oldM] == node_members[i]){
         mod_empty[Nempty] = oldM;
         Nempty++;
       }
@@ -578,16 +687,16 @@ void Greedy::determMove(vector<int> &moveTo){
       exit_log_exit -= plogp(mod_exit[oldM]) + plogp(mod_exit[newM]);
       size_log_size -= plogp(mod_exit[oldM] + mod_size[oldM]) + plogp(mod_exit[newM] + mod_size[newM]); 
       
-      mod_exit[oldM] -= node[i]->exit - outFlowOldM - inFlowOldM;
-      mod_size[oldM] -= node[i]->size;
-      mod_danglingSize[oldM] -= node[i]->danglingSize;
-      mod_teleportWeight[oldM] -= node[i]->teleportWeight;
-      mod_members[oldM] -= node[i]->members.size();
-      mod_exit[newM] += node[i]->exit - outFlowNewM - inFlowNewM;
-      mod_size[newM] += node[i]->size;
-      mod_danglingSize[newM] += node[i]->danglingSize;
-      mod_teleportWeight[newM] += node[i]->teleportWeight;
-      mod_members[newM] += node[i]->members.size();
+      mod_exit[oldM] -= node_exit[i] - outFlowOldM - inFlowOldM;
+      mod_size[oldM] -= node_size[i];
+      mod_danglingSize[oldM] -= node_danglingSize[i];
+      mod_teleportWeight[oldM] -= node_teleportWeight[i];
+      mod_members[oldM] -= node_members[i];
+      mod_exit[newM] += node_exit[i] - outFlowNewM - inFlowNewM;
+      mod_size[newM] += node_size[i];
+      mod_danglingSize[newM] += node_danglingSize[i];
+      mod_teleportWeight[newM] += node_teleportWeight[i];
+      mod_members[newM] += node_members[i];
       
       exitFlow += mod_exit[oldM] + mod_exit[newM];
       exit_log_exit += plogp(mod_exit[oldM]) + plogp(mod_exit[newM]);
@@ -597,6 +706,7 @@ void Greedy::determMove(vector<int> &moveTo){
       codeLength = exit - 2.0*exit_log_exit + size_log_size - nodeSize_log_nodeSize;
       
       node[i]->index = newM;
+      node_index[i] = newM;
       
     }
     
@@ -606,6 +716,8 @@ void Greedy::determMove(vector<int> &moveTo){
 
 void Greedy::eigenvector(void){
   
+  PerfRegion region(PERF_EIGENVECTOR);
+  
   // cout << "Calculating steady state distribution of flow..."; 
   
   vector<double> size_tmp = vector<double>(Nnode,1.0/Nnode);
@@ -1,10 +1,11 @@
 #ifndef GREEDY_H
 #define GREEDY_H
 
-#include "MersenneTwister.h"
+#include "Random.h"
 #include "GreedyBase.h"
 #include "Node.h"
 #include <cmath>
+#include <climits>
 #include <iostream>
 #include <vector>
 #include <queue>
@@ -18,7 +19,7 @@ using namespace std;
 
 class Greedy : public GreedyBase{
  public:
-  Greedy(MTRand *RR,int nnode,Node **node,int nmembers);
+  Greedy(Random *RR,int nnode,Node **node,int nmembers);
   virtual ~Greedy();
   virtual void initiate(void);
   virtual void calibrate(void);
@@ -26,6 +27,7 @@ class Greedy : public GreedyBase{
   virtual void prepare(bool sort);
   virtual void level(Node ***,bool sort);
   virtual void move(bool &moved);
+  virtual void moveSet(vector<int> &active,bool &moved);
   virtual void determMove(vector<int> &moveTo);
   virtual void eigenvector(void);
 
@@ -41,8 +43,28 @@ class Greedy : public GreedyBase{
   vector<int> mod_members;
   
  protected:
+  void scratch(void);
+  bool moveNode(int flip);
+  void prefetchModule(vector<pair<int,double> > &links,int j,int Nlinks);
   
   vector<int> modSnode;
+  
+  // Fields of the nodes read in the sweeps, in contiguous arrays set by
+  // calibrate. node_index is updated with node[i]->index by every move.
+  vector<int> node_index;
+  vector<double> node_exit;
+  vector<double> node_size;
+  vector<double> node_danglingSize;
+  vector<double> node_teleportWeight;
+  vector<int> node_members;
+  
+  // Module links of the node being moved, valid from offset on
+  unsigned int offset;
+  vector<unsigned int> redirect;
+  vector<pair<int,pair<double,double> > > flowNtoM;
+  // Nodes queued for the next sweep of moveSet carry the current stamp
+  unsigned int queueStamp;
+  vector<unsigned int> queued;
 };
 
 #endif
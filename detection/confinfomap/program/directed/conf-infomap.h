@@ -7,11 +7,18 @@
 #include <sstream>
 #include <fstream>
 #include <iomanip>
-#include "MersenneTwister.h"
+#include "Random.h"
 #include "GreedyBase.h" 
 #include "Greedy.h" 
 #include "Node.h"
-#include "stocc.h"
+#include "PerfCounters.h"
+#include "AllocTracker.h"
+#include "Checkpoint.h"
+#include "CoCluster.h"
+#include "ConfCore.h"
+#include "BootSkeleton.h"
+#include "BootClusterStore.h"
+#include "SubNet.h"
 using namespace std;
 
 unsigned stou(char *s);
@@ -49,6 +56,60 @@ inline std::string to_string (const T& t){
   return ss.str();
 }
 
+// Index of the first --option argument, or argc if there are none
+int firstOption(int argc,char *argv[]){
+  for(int i=1;i<argc;i++)
+    if(strncmp(argv[i],"--",2) == 0)
+      return i;
+  return argc;
+}
+
+// Read a partition in Pajek's .clu format, as written by the programs, and
+// number every module by its first node. Moving each node to the module of
+// its first member never fills a module that has been emptied, as determMove
+// expects.
+void loadPartition(string file,int Nnode,vector<int> &cluster){
+  
+  cout << "Reading initial partition " << file << "..." << flush;
+  ifstream clu(file.c_str());
+  if(!clu){
+    cout << "cannot open the file...exiting" << endl;
+    exit(-1);
+  }
+  string line;
+  string buf;
+  istringstream ss;
+  int Nclu = -1;
+  while(Nclu < 0 && getline(clu,line)){
+    ss.clear();
+    ss.str(line);
+    buf = "";
+    ss >> buf;
+    if(buf == "*Vertices" || buf == "*vertices" || buf == "*VERTICES")
+      ss >> Nclu;
+  }
+  if(Nclu != Nnode){
+    cout << "the partition has " << Nclu << " nodes, the network " << Nnode << "...exiting" << endl;
+    exit(-1);
+  }
+  
+  cluster = vector<int>(Nnode);
+  map<int,int> first;
+  for(int i=0;i<Nnode;i++){
+    int mod;
+    if(!(clu >> mod)){
+      cout << "the partition ends after " << i << " nodes...exiting" << endl;
+      exit(-1);
+    }
+    map<int,int>::iterator it = first.find(mod);
+    if(it == first.end())
+      it = first.insert(make_pair(mod,i)).first;
+    cluster[i] = it->second;
+  }
+  cout << "done! (" << first.size() << " modules)" << endl;
+  
+}
+
 void cpyNode(Node *newNode,Node *oldNode){
   
   newNode->index = oldNode->index;
@@ -0,0 +1,146 @@
+#include "AllocTracker.h"
+#include "PerfCounters.h"
+#include <cstdlib>
+#include <new>
+#include <sys/resource.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#if __cplusplus >= 201103L
+#define ALLOC_THROW
+#define ALLOC_NOTHROW noexcept
+#else
+#define ALLOC_THROW throw(std::bad_alloc)
+#define ALLOC_NOTHROW throw()
+#endif
+
+static bool allocAsked = false;
+static bool allocOn = false;
+static long allocLive = 0;
+// Allocations are charged to the innermost phase, the last entry is "other"
+static long allocCount[PERF_NPHASES+1];
+static long allocBytes[PERF_NPHASES+1];
+// Largest number of live bytes while the phase was active, the last entry for the whole run
+static long allocPeak[PERF_NPHASES+1];
+
+static void allocUpdatePeak(long *peak,long live){
+  long old = *peak;
+  while(live > old && !__sync_bool_compare_and_swap(peak,old,live))
+    old = *peak;
+}
+
+static void *allocTracked(size_t size){
+
+  void *p = malloc(size > 0 ? size : 1);
+#ifdef __GLIBC__
+  if(p != NULL && allocOn){
+    long bytes = malloc_usable_size(p);
+    int phase = perfPhase();
+    __sync_fetch_and_add(&allocCount[phase],1);
+    __sync_fetch_and_add(&allocBytes[phase],bytes);
+    long live = __sync_add_and_fetch(&allocLive,bytes);
+    for(int i=0;i<PERF_NPHASES;i++)
+      if(perfActive(i))
+        allocUpdatePeak(&allocPeak[i],live);
+    allocUpdatePeak(&allocPeak[PERF_NPHASES],live);
+  }
+#endif
+  return p;
+
+}
+
+// Blocks allocated before allocEnable were never counted, so live bytes are
+// kept from going below zero when they are freed
+static void allocSubLive(long bytes){
+  long old = allocLive;
+  while(!__sync_bool_compare_and_swap(&allocLive,old,old > bytes ? old - bytes : 0))
+    old = allocLive;
+}
+
+static void allocRelease(void *p){
+
+  if(p == NULL)
+    return;
+#ifdef __GLIBC__
+  if(allocOn)
+    allocSubLive(malloc_usable_size(p));
+#endif
+  free(p);
+
+}
+
+void *operator new(size_t size) ALLOC_THROW {
+  void *p = allocTracked(size);
+  if(p == NULL)
+    throw std::bad_alloc();
+  return p;
+}
+
+void *operator new[](size_t size) ALLOC_THROW {
+  void *p = allocTracked(size);
+  if(p == NULL)
+    throw std::bad_alloc();
+  return p;
+}
+
+void *operator new(size_t size,const std::nothrow_t &) ALLOC_NOTHROW {
+  return allocTracked(size);
+}
+
+void *operator new[](size_t size,const std::nothrow_t &) ALLOC_NOTHROW {
+  return allocTracked(size);
+}
+
+void operator delete(void *p) ALLOC_NOTHROW {
+  allocRelease(p);
+}
+
+void operator delete[](void *p) ALLOC_NOTHROW {
+  allocRelease(p);
+}
+
+void operator delete(void *p,const std::nothrow_t &) ALLOC_NOTHROW {
+  allocRelease(p);
+}
+
+void operator delete[](void *p,const std::nothrow_t &) ALLOC_NOTHROW {
+  allocRelease(p);
+}
+
+bool allocEnable(void){
+
+  allocAsked = true;
+#ifdef __GLIBC__
+  perfTrackPhases();
+  allocOn = true;
+  return true;
+#else
+  cout << "Allocation tracking unavailable with this C library, continuing without it." << endl;
+  return false;
+#endif
+
+}
+
+void allocPrint(ostream &out){
+
+  if(!allocAsked)
+    return;
+  struct rusage usage;
+  getrusage(RUSAGE_SELF,&usage);
+
+  if(allocOn){
+    out << "Heap allocations:" << endl;
+    for(int i=0;i<=PERF_NPHASES;i++){
+      if(allocCount[i] == 0 && (i == PERF_NPHASES || allocPeak[i] == 0))
+        continue;
+      out << "  " << perfPhaseName(i) << ": " << allocCount[i] << " allocations, " << allocBytes[i]/1048576.0 << " MB";
+      if(i < PERF_NPHASES)
+        out << ", peak " << allocPeak[i]/1048576.0 << " MB live";
+      out << endl;
+    }
+    out << "  peak " << allocPeak[PERF_NPHASES]/1048576.0 << " MB live during the run" << endl;
+  }
+  out << "Peak resident set size: " << usage.ru_maxrss/1024.0 << " MB" << endl;
+
+}
@@ -0,0 +1,176 @@
+#include "BootClusterStore.h"
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+BootClusterStore::BootClusterStore(int nnode,int maxboots,string f){
+
+  Nnode = nnode;
+  maxBoots = maxboots;
+  Nboots = 0;
+  width = vector<int>(maxBoots,0);
+  file = f;
+  cols = NULL;
+  Nwritten = 0;
+  fileSize = 0;
+  fd = -1;
+  mapSize = 0;
+  mapped = NULL;
+  if(file.empty())
+    columns = vector<vector<unsigned char> >(maxBoots);
+  else{
+    colStart = vector<long long>(maxBoots,0);
+    string name = file + ".cols";
+    cols = fopen(name.c_str(),"w+b");
+    if(cols == NULL){
+      cout << "Cannot write bootstrap file " << name << "...exiting" << endl;
+      exit(-1);
+    }
+  }
+
+}
+
+BootClusterStore::~BootClusterStore(){
+
+  if(mapped != NULL)
+    munmap(mapped,mapSize);
+  if(fd >= 0)
+    close(fd);
+  if(cols != NULL){
+    fclose(cols);
+    unlink((file + ".cols").c_str());
+    unlink(file.c_str());
+  }
+
+}
+
+void BootClusterStore::put(int bootstrap,vector<int> &cluster){
+
+  int maxLabel = 0;
+  for(int i=0;i<Nnode;i++)
+    if(cluster[i] > maxLabel)
+      maxLabel = cluster[i];
+  int w = maxLabel < 256 ? 1 : (maxLabel < 65536 ? 2 : 4);
+  width[bootstrap] = w;
+
+  vector<unsigned char> column(static_cast<size_t>(Nnode)*w);
+  for(int i=0;i<Nnode;i++){
+    if(w == 1)
+      column[i] = static_cast<unsigned char>(cluster[i]);
+    else if(w == 2){
+      unsigned short label = static_cast<unsigned short>(cluster[i]);
+      memcpy(&column[2*static_cast<size_t>(i)],&label,2);
+    }
+    else
+      memcpy(&column[4*static_cast<size_t>(i)],&cluster[i],4);
+  }
+
+  if(cols == NULL){
+    columns[bootstrap].swap(column);
+    return;
+  }
+  if(bootstrap < Nwritten) // Its segment is stale, write file again
+    Nwritten = 0;
+  // A bootstrap that is put again is appended again
+  if(fseeko(cols,0,SEEK_END) != 0 || (colStart[bootstrap] = ftello(cols)) < 0 || fwrite(&column[0],1,column.size(),cols) != column.size()){
+    cout << "Cannot write bootstrap file " << file << ".cols...exiting" << endl;
+    exit(-1);
+  }
+
+}
+
+void BootClusterStore::finish(int nboots){
+
+  Nboots = nboots;
+  for(int k=0;k<Nboots;k++){
+    if(width[k] == 0){
+      cout << "Partition of bootstrap " << k+1 << " is missing...exiting" << endl;
+      exit(-1);
+    }
+  }
+  prefix = vector<int>(Nboots+1,0);
+  for(int k=0;k<Nboots;k++)
+    prefix[k+1] = prefix[k] + width[k];
+  if(cols == NULL)
+    return;
+
+  if(Nboots < Nwritten)
+    Nwritten = 0;
+  if(Nboots == Nwritten && mapped != NULL)
+    return;
+
+  if(mapped != NULL){
+    munmap(mapped,mapSize);
+    mapped = NULL;
+  }
+  if(fd >= 0){
+    close(fd);
+    fd = -1;
+  }
+
+  if(Nwritten == 0){
+    segStart.clear();
+    segOffset.clear();
+    fileSize = 0;
+  }
+  FILE *out = fopen(file.c_str(),Nwritten == 0 ? "wb" : "ab");
+  if(out == NULL){
+    cout << "Cannot write bootstrap file " << file << "...exiting" << endl;
+    exit(-1);
+  }
+  // New segment with the bootstraps put since the last finish
+  if(Nboots > Nwritten){
+    segStart.push_back(Nwritten);
+    segOffset.push_back(fileSize);
+    vector<unsigned char> buf(static_cast<size_t>(BOOTSTORE_BLOCK)*4);
+    for(int first=0;first<Nnode;first+=BOOTSTORE_BLOCK){
+      int blockLen = Nnode-first < BOOTSTORE_BLOCK ? Nnode-first : BOOTSTORE_BLOCK;
+      for(int k=Nwritten;k<Nboots;k++){
+        size_t n = static_cast<size_t>(blockLen)*width[k];
+        if(fseeko(cols,colStart[k] + static_cast<long long>(first)*width[k],SEEK_SET) != 0 || fread(&buf[0],1,n,cols) != n || fwrite(&buf[0],1,n,out) != n){
+          cout << "Cannot write bootstrap file " << file << "...exiting" << endl;
+          exit(-1);
+        }
+      }
+    }
+    fileSize += static_cast<long long>(Nnode)*(prefix[Nboots]-prefix[Nwritten]);
+    Nwritten = Nboots;
+  }
+  fclose(out);
+
+  mapSize = fileSize;
+  if(mapSize == 0)
+    return;
+  fd = open(file.c_str(),O_RDONLY);
+  void *p = fd < 0 ? MAP_FAILED : mmap(NULL,mapSize,PROT_READ,MAP_SHARED,fd,0);
+  if(p == MAP_FAILED){
+    cout << "Cannot map bootstrap file " << file << "...exiting" << endl;
+    exit(-1);
+  }
+  mapped = static_cast<unsigned char *>(p);
+
+}
+
+void BootClusterStore::labels(int node,int *out){
+
+  if(cols == NULL){
+    for(int k=0;k<Nboots;k++)
+      out[k] = decode(&columns[k][static_cast<size_t>(node)*width[k]],width[k]);
+    return;
+  }
+  int first = node - node%BOOTSTORE_BLOCK;
+  int blockLen = Nnode-first < BOOTSTORE_BLOCK ? Nnode-first : BOOTSTORE_BLOCK;
+  int rel = node - first;
+  int Nseg = segStart.size();
+  for(int s=0;s<Nseg;s++){
+    int a = segStart[s];
+    int b = s+1 < Nseg ? segStart[s+1] : Nboots;
+    const unsigned char *block = mapped + segOffset[s] + static_cast<size_t>(first)*(prefix[b]-prefix[a]);
+    for(int k=a;k<b;k++)
+      out[k] = decode(block + static_cast<size_t>(blockLen)*(prefix[k]-prefix[a]) + static_cast<size_t>(rel)*width[k],width[k]);
+  }
+
+}
@@ -0,0 +1,84 @@
+#include "BootSkeleton.h"
+#include <cmath>
+#include <algorithm>
+
+BootSkeleton::BootSkeleton(map<int,map<int,double> > &Links,int nnode,bool directed){
+
+  Nnode = nnode;
+  vector<int> from;
+  vector<int> to;
+  for(map<int,map<int,double> >::iterator fromLink_it = Links.begin(); fromLink_it != Links.end(); fromLink_it++){
+    for(map<int,double>::iterator toLink_it = fromLink_it->second.begin(); toLink_it != fromLink_it->second.end(); toLink_it++){
+      if(fromLink_it->first == toLink_it->first)
+        continue;
+      from.push_back(fromLink_it->first);
+      to.push_back(toLink_it->first);
+      mean.push_back(toLink_it->second);
+      sd.push_back(sqrt(toLink_it->second));
+    }
+  }
+  Nlinks = mean.size();
+  weight = vector<double>(Nlinks);
+
+  if(directed){
+    fillRows(out,from,to,false);
+    fillRows(in,to,from,false);
+  }
+  else
+    fillRows(out,from,to,true);
+
+}
+
+// Rows of the links by from, and also by to if both
+void BootSkeleton::fillRows(Rows &rows,vector<int> &from,vector<int> &to,bool both){
+
+  rows.start = vector<int>(Nnode+1,0);
+  for(int l=0;l<Nlinks;l++){
+    rows.start[from[l]+1]++;
+    if(both)
+      rows.start[to[l]+1]++;
+  }
+  for(int i=0;i<Nnode;i++)
+    rows.start[i+1] += rows.start[i];
+
+  int Nentries = rows.start[Nnode];
+  rows.nb = vector<int>(Nentries);
+  rows.link = vector<int>(Nentries);
+  vector<int> fill(rows.start.begin(),rows.start.end()-1);
+  for(int l=0;l<Nlinks;l++){
+    int p = fill[from[l]]++;
+    rows.nb[p] = to[l];
+    rows.link[p] = l;
+    if(both){
+      p = fill[to[l]]++;
+      rows.nb[p] = from[l];
+      rows.link[p] = l;
+    }
+  }
+
+}
+
+void BootSkeleton::resample(Random &R){
+
+  double u[GAUSS_BATCH/2];
+  double v[GAUSS_BATCH/2];
+  double z[GAUSS_BATCH];
+  for(int first=0;first<Nlinks;first+=GAUSS_BATCH){
+    int n = min(GAUSS_BATCH,Nlinks-first);
+    int Npairs = (n+1)/2;
+    for(int k=0;k<Npairs;k++){
+      u[k] = 1.0 - R.randExc(); // In (0,1] for the logarithm
+      v[k] = R.randExc();
+    }
+    // Box-Muller, two normal numbers from each pair
+    for(int k=0;k<Npairs;k++){
+      double r = sqrt(-2.0*log(u[k]));
+      double t = 2.0*M_PI*v[k];
+      z[2*k] = r*cos(t);
+      z[2*k+1] = r*sin(t);
+    }
+    for(int k=0;k<n;k++)
+      weight[first+k] = mean[first+k] + sd[first+k]*z[k];
+  }
+
+}
@@ -0,0 +1,105 @@
+#include "Checkpoint.h"
+#include <iostream>
+#include <cstdlib>
+#include <unistd.h>
+
+#define CHECKPOINT_MAGIC 0x31504B43 // "CKP1"
+
+Checkpoint::Checkpoint(string f,unsigned long seed,int Nnode,int Nlinks,int Nbootstraps,int Ntrials){
+
+  file = f;
+  out = NULL;
+  header[0] = CHECKPOINT_MAGIC;
+  header[1] = static_cast<int>(seed);
+  header[2] = Nnode;
+  header[3] = Nlinks;
+  header[4] = Nbootstraps;
+  header[5] = Ntrials;
+
+}
+
+Checkpoint::~Checkpoint(){
+  if(out != NULL)
+    fclose(out);
+}
+
+int Checkpoint::resume(BootClusterStore &bootClusters,vector<bool> &bootDone,vector<int> &netCluster){
+
+  FILE *in = fopen(file.c_str(),"rb");
+  if(in == NULL)
+    return 0;
+
+  int old[6];
+  if(fread(old,sizeof(int),6,in) != 6){
+    fclose(in);
+    return 0;
+  }
+  // The number of bootstraps may change, their streams do not depend on it
+  if(old[0] != header[0] || old[1] != header[1] || old[2] != header[2] || old[3] != header[3] || old[5] != header[5]){
+    cout << "Checkpoint " << file << " is from another network, seed or number of attempts...exiting" << endl;
+    exit(-1);
+  }
+
+  int Nnode = header[2];
+  int Nfound = 0;
+  long goodEnd = ftell(in);
+  vector<int> cluster(Nnode);
+  int tag;
+  while(fread(&tag,sizeof(int),1,in) == 1){
+    if(fread(&cluster[0],sizeof(int),Nnode,in) != static_cast<size_t>(Nnode))
+      break; // Record cut short when the run was killed
+    goodEnd = ftell(in);
+    if(tag == -1)
+      netCluster = cluster;
+    else if(tag >= 0 && tag < bootClusters.maxBoots){
+      if(!bootDone[tag])
+        Nfound++;
+      bootClusters.put(tag,cluster);
+      bootDone[tag] = true;
+    }
+  }
+  fclose(in);
+
+  // Drop a partial record before appending new ones
+  if(truncate(file.c_str(),goodEnd) != 0){
+    cout << "Cannot truncate checkpoint " << file << "...exiting" << endl;
+    exit(-1);
+  }
+  out = fopen(file.c_str(),"ab");
+  if(out == NULL){
+    cout << "Cannot write checkpoint " << file << "...exiting" << endl;
+    exit(-1);
+  }
+  return Nfound;
+
+}
+
+void Checkpoint::open(void){
+
+  out = fopen(file.c_str(),"wb");
+  if(out == NULL){
+    cout << "Cannot write checkpoint " << file << "...exiting" << endl;
+    exit(-1);
+  }
+  fwrite(header,sizeof(int),6,out);
+
+}
+
+void Checkpoint::writeRecord(int tag,vector<int> &cluster){
+
+  if(out == NULL)
+    open();
+  fwrite(&tag,sizeof(int),1,out);
+  fwrite(&cluster[0],sizeof(int),cluster.size(),out);
+  fflush(out);
+  fsync(fileno(out));
+
+}
+
+void Checkpoint::writeBootstrap(int bootstrap,vector<int> &cluster){
+  writeRecord(bootstrap,cluster);
+}
+
+void Checkpoint::writeNetwork(vector<int> &cluster){
+  writeRecord(-1,cluster);
+}
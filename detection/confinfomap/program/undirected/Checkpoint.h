@@ -0,0 +1,36 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "BootClusterStore.h"
+using namespace std;
+
+// Binary checkpoint of a significance analysis: a header with the run
+// parameters followed by one record per finished partition, the bootstrap
+// number (-1 for the original network) and the module of every node as
+// 32-bit integers. Records are appended and flushed to disk as soon as a
+// partition is done, so a killed run loses at most the running bootstrap.
+// Every bootstrap and the original network draw from random streams given
+// by the seed and their number, so no generator state needs to be stored.
+class Checkpoint{
+ public:
+  Checkpoint(string file,unsigned long seed,int Nnode,int Nlinks,int Nbootstraps,int Ntrials);
+  ~Checkpoint();
+  // Read the records of an earlier run with the same parameters, returns
+  // the number of bootstraps found
+  int resume(BootClusterStore &bootClusters,vector<bool> &bootDone,vector<int> &netCluster);
+  void writeBootstrap(int bootstrap,vector<int> &cluster);
+  void writeNetwork(vector<int> &cluster);
+
+ private:
+  void open(void);
+  void writeRecord(int tag,vector<int> &cluster);
+
+  string file;
+  FILE *out;
+  int header[6];
+};
+
+#endif
@@ -1,10 +1,12 @@
 #ifndef GREEDY_H
 #define GREEDY_H
 
-#include "MersenneTwister.h"
+#include "Random.h"
 #include "GreedyBase.h"
 #include "Node.h"
 #include <cmath>
+#include <cfloat>
+#include <climits>
 #include <iostream>
 #include <vector>
 #include <queue>
@@ -18,7 +20,7 @@ using namespace std;
 
 class Greedy : public GreedyBase{
  public:
-  Greedy(MTRand *RR,int nnode,double deg,Node **node);
+  Greedy(Random *RR,int nnode,double deg,Node **node);
   virtual ~Greedy();
   virtual void initiate(void);
   virtual void calibrate(void);
@@ -26,7 +28,9 @@ class Greedy : public GreedyBase{
   virtual void prepare(bool sort);
   virtual void level(Node ***, bool sort);
   virtual void move(bool &moved);
+  virtual void moveSet(vector<int> &active,bool &moved);
   virtual void determMove(vector<int> &moveTo);
+  virtual bool drifted(void);
   
   int Nempty;
   vector<int> mod_empty;
@@ -37,8 +41,42 @@ class Greedy : public GreedyBase{
   
  protected:
   double plogp(double d);
-  vector<pair<int,double> >::iterator link;
+  void compAdd(double &s,double &c,double x,double scale);
+  void shift(int i,int fromM,int toM,double wfromM,double wtoM);
+  void resetDrift(void);
+  void scratch(void);
+  bool moveNode(int flip);
+#if defined(VARINT_LINKS)
+  void prefetchModule(int j,int Nlinks);
+#else
+  void prefetchModule(LinkCursor &far,LinkCursor &near);
+#endif
   vector<int> modWnode;
+  
+  // Fields of the nodes read in the sweeps, in contiguous arrays set by
+  // calibrate. node_index is updated with node[i]->index by every move.
+  vector<int> node_index;
+  vector<double> node_exit;
+  vector<double> node_degree;
+  vector<int> node_members;
+  
+  // Module links of the node being moved, valid from offset on
+  unsigned int offset;
+  vector<unsigned int> redirect;
+  vector<pair<int,double> > wNtoM;
+  // Nodes queued for the next sweep of moveSet carry the current stamp
+  unsigned int queueStamp;
+  vector<unsigned int> queued;
+  
+  // Rounding errors of the sums updated by moves, and a bound on how much
+  // they may have changed the code length since the last tune or calibrate
+  vector<double> mod_exit_c;
+  vector<double> mod_degree_c;
+  double exitDegree_c;
+  double exit_log_exit_c;
+  double degree_log_degree_c;
+  double weightScale;
+  double drift;
 };
 
 #endif
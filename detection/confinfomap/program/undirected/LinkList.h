@@ -0,0 +1,136 @@
+#ifndef LINKLIST_H
+#define LINKLIST_H
+
+#include <vector>
+#include <utility>
+using namespace std;
+
+// Links of a node or module as pairs of neighbor identity and link weight,
+// read in order with a LinkCursor.
+// Built with COMPACT_LINKS defined (make COMPACT=1), the identities are kept
+// as 32-bit integers and the weights as floats in two separate arrays, 8 bytes
+// per link instead of 16. Links are then read by value and sums over links are
+// still accumulated in double.
+// Built with VARINT_LINKS defined (make VARINT=1), each identity is stored as
+// the difference to the previous one, zigzag-encoded in 7-bit groups, so one
+// or two bytes per link when neighbors have nearby numbers (see --reorder).
+// The weights are floats, and a single float as long as all weights of the
+// node are equal, as in unweighted networks.
+#if defined(VARINT_LINKS)
+
+class LinkList{
+ public:
+  LinkList() : n(0), last(0), w0(0.0f) {}
+  int size(void) const { return n; }
+  bool empty(void) const { return n == 0; }
+  void push_back(const pair<int,double> &link){
+    int delta = link.first - last;
+    unsigned int zz = (static_cast<unsigned int>(delta) << 1) ^ static_cast<unsigned int>(delta >> 31);
+    while(zz >= 0x80){
+      ids.push_back(static_cast<unsigned char>(zz | 0x80));
+      zz >>= 7;
+    }
+    ids.push_back(static_cast<unsigned char>(zz));
+    last = link.first;
+    float wf = static_cast<float>(link.second);
+    if(n == 0)
+      w0 = wf;
+    else if(w.empty() && wf != w0)
+      w.assign(n,w0);
+    if(!w.empty())
+      w.push_back(wf);
+    n++;
+  }
+  void reserve(int k){ ids.reserve(k); }
+  void clear(void){ ids.clear(); w.clear(); n = 0; last = 0; }
+
+ private:
+  friend class LinkCursor;
+  vector<unsigned char> ids;
+  vector<float> w; // Empty while all weights are w0
+  int n;
+  int last;
+  float w0;
+};
+
+class LinkCursor{
+ public:
+  LinkCursor(const LinkList &l) : links(l), p(l.ids.empty() ? NULL : &l.ids[0]), j(0), id(0) {}
+  bool next(int &nb,double &weight){
+    if(j == links.n)
+      return false;
+    unsigned int zz = 0;
+    int shift = 0;
+    unsigned char b;
+    do{
+      b = *p++;
+      zz |= static_cast<unsigned int>(b & 0x7F) << shift;
+      shift += 7;
+    } while(b & 0x80);
+    id += static_cast<int>((zz >> 1) ^ (0U - (zz & 1)));
+    nb = id;
+    weight = links.w.empty() ? links.w0 : links.w[j];
+    j++;
+    return true;
+  }
+  void skip(int k){
+    int nb;
+    double weight;
+    for(int i=0;i<k && next(nb,weight);i++)
+      ;
+  }
+ private:
+  const LinkList &links;
+  const unsigned char *p;
+  int j;
+  int id;
+};
+
+#else
+
+#if defined(COMPACT_LINKS)
+
+class LinkList{
+ public:
+  int size(void) const { return nb.size(); }
+  bool empty(void) const { return nb.empty(); }
+  pair<int,double> operator[](int j) const { return make_pair(nb[j],static_cast<double>(w[j])); }
+  void push_back(const pair<int,double> &link){
+    nb.push_back(link.first);
+    w.push_back(static_cast<float>(link.second));
+  }
+  void reserve(int n){ nb.reserve(n); w.reserve(n); }
+  void clear(void){ nb.clear(); w.clear(); }
+
+ private:
+  vector<int> nb;
+  vector<float> w;
+};
+
+#else
+
+typedef vector<pair<int,double> > LinkList;
+
+#endif
+
+class LinkCursor{
+ public:
+  LinkCursor(const LinkList &l) : links(l), n(l.size()), j(0) {}
+  bool next(int &nb,double &weight){
+    if(j == n)
+      return false;
+    nb = links[j].first;
+    weight = links[j].second;
+    j++;
+    return true;
+  }
+  void skip(int k){ j = (j + k < n) ? j + k : n; }
+ private:
+  const LinkList &links;
+  int n;
+  int j;
+};
+
+#endif
+
+#endif
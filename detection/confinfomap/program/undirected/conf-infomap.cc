@@ -9,104 +9,141 @@ unsigned stou(char *s){
   return strtoul(s,(char **)NULL,10);
 }
 
-void partition(MTRand *R,Node ***node, GreedyBase *greedy, bool silent);
-void repeated_partition(MTRand *R, Node ***node, GreedyBase *greedy, bool silent,int Ntrials);
+void partition(Random *R,Node ***node, GreedyBase *greedy, bool silent);
+void repeated_partition(Random *R, Node ***node, GreedyBase *greedy, bool silent,int Ntrials,vector<int> &initCluster);
 void printTree(string s,multimap<double,treeNode,greater<double> >::iterator it_tM,ofstream *outfile);
 void printSignificantTree(string s,multimap<double,treeNode,greater<double> >::iterator it_tM,ofstream *outfile,vector<bool> &significantVec);
-void findConfCore(multimap<double,treeNode,greater<double> > &treeMap,vector<vector<int > > &bootClusters,vector<bool> &significantVec,double conf,MTRand *R);
-void findConfModules(multimap<double,treeNode,greater<double> > &treeMap,vector<vector<int > > &bootClusters,vector<bool> &significantVec,vector<pair<int,int> > &mergers,double conf);
+void findConfCore(multimap<double,treeNode,greater<double> > &treeMap,BootClusterStore &bootClusters,vector<bool> &significantVec,double conf,Random *R,bool silent);
+void findConfModules(multimap<double,treeNode,greater<double> > &treeMap,BootClusterStore &bootClusters,vector<bool> &significantVec,vector<pair<int,int> > &mergers,double conf,bool silent);
+bool significanceStable(multimap<double,treeNode,greater<double> > &treeMap,BootClusterStore &bootClusters,int Nboots,double conf,Random *R,double tolerance,vector<bool> &lastSignificant,vector<pair<int,int> > &lastMergers);
 
 // Call: trade <seed> <Ntries>
 int main(int argc,char *argv[]){
   
-  if( argc < 3 ){
-    cout << "Call: ./conf-infomap <seed> <network.net> <# attempts/network [10]> <# bootstrap resamples [100]> <conf level [0.90]>" << endl;
+  // Options of the form --name follow the positional arguments
+  int Nargs = firstOption(argc,argv);
+  if( Nargs < 3 ){
+    cout << "Call: ./conf-infomap <seed> <network.net> <# attempts/network [10]> <# bootstrap resamples [100]> <conf level [0.90]> [--perf] [--alloc-stats] [--checkpoint] [--resume] [--link-order shuffle|rotate|tiebreak] [--active-set] [--init-partition file.clu] [--warm-only] [--early-stop K] [--stop-tolerance f] [--warm-bootstraps N>=1] [--boot-disk]" << endl;
     exit(-1);
   }
 
-  MTRand *R = new MTRand(stou(argv[1])); // Set random seed
-  StochasticLib1 sto(atoi(argv[1]));
+  Random *R = new Random(stou(argv[1])); // Set random seed
   string networkFile = string(argv[2]);
   int Ntrials = 10;
-  if(argc > 3)
+  if(Nargs > 3)
     Ntrials = atoi(argv[3]); // Set number of partition attempts
   int Nbootstraps = 100;
-  if(argc > 4)
+  if(Nargs > 4)
     Nbootstraps = atoi(argv[4]); // Number of network resamples
   double conf = 0.90;
-  if(argc > 5)
+  if(Nargs > 5)
     conf = atof(argv[5]); // Confidence level. 
+  bool checkpoint = false;
+  bool resume = false;
+  string initFile;
+  bool warmOnly = false;
+  int stopEvery = 0;
+  double stopTolerance = 0.01;
+  bool warmBoot = false;
+  int NfreshBoot = 0;
+  bool bootDisk = false;
+  for(int i=Nargs;i<argc;i++){
+    string option = to_string(argv[i]);
+    if(option == "--perf")
+      perfEnable();
+    else if(option == "--alloc-stats")
+      allocEnable();
+    else if(option == "--checkpoint")
+      checkpoint = true;
+    else if(option == "--resume"){
+      checkpoint = true;
+      resume = true;
+    }
+    else if(option == "--init-partition" && i+1 < argc)
+      initFile = string(argv[++i]);
+    else if(option == "--warm-only")
+      warmOnly = true;
+    else if(option == "--early-stop" && i+1 < argc){
+      stopEvery = atoi(argv[++i]);
+      if(stopEvery < 1){
+        cout << "--early-stop needs a positive number of bootstraps...exiting" << endl;
+        exit(-1);
+      }
+    }
+    else if(option == "--stop-tolerance" && i+1 < argc)
+      stopTolerance = atof(argv[++i]);
+    else if(option == "--warm-bootstraps" && i+1 < argc){
+      warmBoot = true;
+      NfreshBoot = atoi(argv[++i]);
+      if(NfreshBoot < 1){
+        cout << "--warm-bootstraps needs a number of fresh attempts of at least 1...exiting" << endl;
+        exit(-1);
+      }
+    }
+    else if(option == "--boot-disk")
+      bootDisk = true;
+    else if(option == "--active-set")
+      GreedyBase::activeSet = true;
+    else if(option == "--link-order" && i+1 < argc){
+      string order = to_string(argv[++i]);
+      if(order == "shuffle")
+        GreedyBase::linkOrder = LINKS_SHUFFLE;
+      else if(order == "rotate")
+        GreedyBase::linkOrder = LINKS_ROTATE;
+      else if(order == "tiebreak")
+        GreedyBase::linkOrder = LINKS_TIEBREAK;
+      else{
+        cout << "Unknown link order " << order << "...exiting" << endl;
+        exit(-1);
+      }
+    }
+    else{
+      cout << "Unknown option " << option << "...exiting" << endl;
+      exit(-1);
+    }
+  }
+  if(warmOnly && initFile.empty()){
+    cout << "--warm-only needs --init-partition...exiting" << endl;
+    exit(-1);
+  }
   
   cout << "Running significance analysis on " << networkFile << " with " << Nbootstraps << " bootstrap networks (based on best clustering from " << Ntrials << " attempts per network) and confidence level " << conf << "." << endl; 
   string networkName(networkFile.begin(),networkFile.begin() + networkFile.find_last_of("."));
   
+  perfBegin(PERF_LOAD);
   Network network(networkFile);
   loadPajekNet(network);
+  perfEnd(PERF_LOAD);
   
   int Nnode = network.Nnode;
   
-  /////////// Partition bootstrap networks /////////////////////
-  
-  vector<vector<int > > bootClusters = vector<vector<int > >(Nbootstraps,vector<int>(Nnode));
-  
-  for(int bootstrap = 0;bootstrap < Nbootstraps ; bootstrap++){
-    cout << endl << "Bootstrap " << bootstrap+1 << "/" << Nbootstraps << endl;
-
-    double totalDegree = 0.0;
-    Node **node = new Node*[Nnode];
-    for(int i=0;i<Nnode;i++){
-      node[i] = new Node(i);
-    }
-    
-    int NselfLinks = 0;
-    for(map<int,map<int,double> >::iterator fromLink_it = network.Links.begin(); fromLink_it != network.Links.end(); fromLink_it++){
-      for(map<int,double>::iterator toLink_it = fromLink_it->second.begin(); toLink_it != fromLink_it->second.end(); toLink_it++){
-        
-        int from = fromLink_it->first;
-        int to = toLink_it->first;
-        double weight = toLink_it->second;
-        weight = 1.0*sto.Normal(weight,sqrt(weight)); // Generate normal random number
-        if(weight > 0.0){
-          if(from == to){
-            NselfLinks++;
-          }
-          else{
-            node[from]->links.push_back(make_pair(to,weight));
-            node[to]->links.push_back(make_pair(from,weight));
-            node[from]->degree += weight;
-            node[to]->degree += weight;
-            totalDegree += 2*weight;
-          }
-        }
-      }
-    }
-    
-    // Initiation
-    GreedyBase* greedy;
-    greedy = new Greedy(R,Nnode,totalDegree,node);
-    greedy->initiate();
-    
-    double uncompressedCodeLength = -greedy->nodeDegree_log_nodeDegree;
-    
-    cout << "Now partition the network:" << endl;
-    repeated_partition(R,&node,greedy,false,Ntrials);
-    int Nmod = greedy->Nnode;
-    cout << "Done! Code length " << greedy->codeLength << " in " << Nmod << " modules." << endl;
-    cout << "Compressed by " << 100.0*(1.0-greedy->codeLength/uncompressedCodeLength) << " percent." << endl;
-
-    for(int i=0;i<Nmod;i++){
-      int Nmem = node[i]->members.size();
-      for(int j=0;j<Nmem;j++){
-        bootClusters[bootstrap][node[i]->members[j]] = i; 
-      }
-    }
-    
-    for(int i=0;i<greedy->Nnode;i++){
-      delete node[i];
+  // The bootstrap networks start from singletons, or with --warm-bootstraps
+  // one attempt starts from the partition of the network
+  vector<int> noCluster;
+  vector<int> initCluster;
+  if(!initFile.empty())
+    loadPartition(initFile,Nnode,initCluster);
+  
+  /////////// Bootstrap partitions and checkpoint /////////////////////
+  
+  // With --boot-disk the bootstrap partitions are kept in network.boots
+  BootClusterStore bootClusters(Nnode,Nbootstraps,bootDisk ? networkName + ".boots" : "");
+  Random boot_R = R->split(0); // Separate streams for bootstraps, network and significance
+  
+  vector<bool> bootDone(Nbootstraps,false);
+  vector<int> netCluster;
+  Checkpoint *ckp = NULL;
+  if(checkpoint){
+    // Warm-started bootstraps store their number of attempts in the upper bits
+    int ckpTrials = Ntrials + (warmBoot ? (NfreshBoot+1) << 16 : 0);
+    ckp = new Checkpoint(networkName + ".ckp",stou(argv[1]),Nnode,network.Nlinks,Nbootstraps,ckpTrials);
+    if(resume){
+      int Nfound = ckp->resume(bootClusters,bootDone,netCluster);
+      cout << "Resuming from " << networkName << ".ckp with " << Nfound << " finished bootstrap(s)";
+      if(!netCluster.empty())
+        cout << " and the partition of the network";
+      cout << "." << endl;
     }
-    delete [] node;
-    delete greedy;
-    
   }
   
   /////////// Partition network /////////////////////
@@ -153,18 +190,46 @@ int main(int argc,char *argv[]){
   //  map<int,map<int,double> >().swap(Links);
   
   // Initiation
+  Random net_R = R->split(1);
   GreedyBase* greedy;
-  greedy = new Greedy(R,Nnode,totalDegree,node);
+  greedy = new Greedy(&net_R,Nnode,totalDegree,node);
   greedy->initiate();
   
   double uncompressedCodeLength = -greedy->nodeDegree_log_nodeDegree;
   
-  cout << "Now partition the network:" << endl;
-  repeated_partition(R,&node,greedy,false,Ntrials);
+  if(!netCluster.empty()){
+    cout << "Now apply the partition of the network from the checkpoint." << endl;
+    greedy->determMove(netCluster);
+    greedy->level(&node,false); // Keep the stored module order
+  }
+  else{
+    cout << "Now partition the network:" << endl;
+    repeated_partition(&net_R,&node,greedy,false,warmOnly ? 1 : Ntrials,initCluster);
+    if(ckp != NULL){
+      vector<int> cluster(Nnode);
+      for(int i=0;i<greedy->Nnode;i++){
+        int Nmem = node[i]->members.size();
+        for(int j=0;j<Nmem;j++)
+          cluster[node[i]->members[j]] = i;
+      }
+      ckp->writeNetwork(cluster);
+    }
+  }
   int Nmod = greedy->Nnode;
   cout << "Done! Code length " << greedy->codeLength << " in " << Nmod << " modules." << endl;
   cout << "Compressed by " << 100.0*(1.0-greedy->codeLength/uncompressedCodeLength) << " percent." << endl;
   
+  // Partition of the network, the start of warm-started bootstraps
+  vector<int> netPartition;
+  if(warmBoot){
+    netPartition = vector<int>(Nnode);
+    for(int i=0;i<Nmod;i++){
+      int Nmem = node[i]->members.size();
+      for(int j=0;j<Nmem;j++)
+        netPartition[node[i]->members[j]] = i;
+    }
+  }
+  
   // Order modules by size
   multimap<double,treeNode,greater<double> > treeMap;
   multimap<double,treeNode,greater<double> >::iterator it_tM;
@@ -181,10 +246,12 @@ int main(int argc,char *argv[]){
   // Order links by size
   multimap<double,pair<int,int>,greater<double> > sortedLinks;
   for(int i=0;i<Nmod;i++){
-    int Nlinks = node[i]->links.size();
-    for(int j=0;j<Nlinks;j++){
-      if(i <= node[i]->links[j].first)
-        sortedLinks.insert(make_pair(node[i]->links[j].second/totalDegree,make_pair(i+1,node[i]->links[j].first+1)));
+    LinkCursor link(node[i]->links);
+    int nb;
+    double nb_w;
+    while(link.next(nb,nb_w)){
+      if(i <= nb)
+        sortedLinks.insert(make_pair(nb_w/totalDegree,make_pair(i+1,nb+1)));
     }
   }
   
@@ -220,14 +287,97 @@ int main(int argc,char *argv[]){
     outfile << it->second.first << " " << it->second.second << " " << 1.0*it->first << endl;
   outfile.close();
     
+  /////////// Partition bootstrap networks /////////////////////
+  
+  // Only the link weights differ between the bootstrap networks
+  perfBegin(PERF_LOAD);
+  BootSkeleton skeleton(network.Links,Nnode,false);
+  perfEnd(PERF_LOAD);
+  
+  // Significance with the bootstraps so far, compared every stopEvery bootstraps
+  Random conf_R = R->split(2);
+  vector<bool> lastSignificant;
+  vector<pair<int,int> > lastMergers;
+  int NbootsDone = Nbootstraps;
+  
+  for(int bootstrap = 0;bootstrap < Nbootstraps ; bootstrap++){
+    if(stopEvery > 0 && bootstrap > 0 && bootstrap % stopEvery == 0 && significanceStable(treeMap,bootClusters,bootstrap,conf,&conf_R,stopTolerance,lastSignificant,lastMergers)){
+      NbootsDone = bootstrap;
+      break;
+    }
+    cout << endl << "Bootstrap " << bootstrap+1 << "/" << Nbootstraps << endl;
+    if(bootDone[bootstrap]){
+      cout << "Taken from the checkpoint." << endl;
+      continue;
+    }
+    Random bootstrap_R = boot_R.split(bootstrap); // Own stream for each bootstrap
+    Random weight_R = bootstrap_R.split();
+
+    double totalDegree = 0.0;
+    perfBegin(PERF_LOAD);
+    skeleton.resample(weight_R); // Generate normal random weights
+    Node **node = new Node*[Nnode];
+    for(int i=0;i<Nnode;i++){
+      node[i] = new Node(i);
+      node[i]->links.reserve(skeleton.out.start[i+1]-skeleton.out.start[i]);
+      for(int p=skeleton.out.start[i];p<skeleton.out.start[i+1];p++){
+        double weight = skeleton.weight[skeleton.out.link[p]];
+        if(weight > 0.0){ // Links with non-positive weights are masked
+          node[i]->links.push_back(make_pair(skeleton.out.nb[p],weight));
+          node[i]->degree += weight;
+        }
+      }
+      totalDegree += node[i]->degree;
+    }
+    perfEnd(PERF_LOAD);
+    
+    // Initiation
+    GreedyBase* greedy;
+    greedy = new Greedy(&bootstrap_R,Nnode,totalDegree,node);
+    greedy->initiate();
+    
+    double uncompressedCodeLength = -greedy->nodeDegree_log_nodeDegree;
+    
+    cout << "Now partition the network:" << endl;
+    if(warmBoot) // The first attempt starts from the partition of the network
+      repeated_partition(&bootstrap_R,&node,greedy,false,NfreshBoot+1,netPartition);
+    else
+      repeated_partition(&bootstrap_R,&node,greedy,false,Ntrials,noCluster);
+    int Nmod = greedy->Nnode;
+    cout << "Done! Code length " << greedy->codeLength << " in " << Nmod << " modules." << endl;
+    cout << "Compressed by " << 100.0*(1.0-greedy->codeLength/uncompressedCodeLength) << " percent." << endl;
+
+    vector<int> cluster(Nnode);
+    for(int i=0;i<Nmod;i++){
+      int Nmem = node[i]->members.size();
+      for(int j=0;j<Nmem;j++){
+        cluster[node[i]->members[j]] = i; 
+      }
+    }
+    bootClusters.put(bootstrap,cluster);
+    if(ckp != NULL)
+      ckp->writeBootstrap(bootstrap,cluster);
+    
+    for(int i=0;i<greedy->Nnode;i++){
+      delete node[i];
+    }
+    delete [] node;
+    delete greedy;
+    
+  }
+  
+  if(NbootsDone < Nbootstraps)
+    cout << endl << "Significance is stable after " << NbootsDone << " bootstrap networks, skipping the remaining " << Nbootstraps-NbootsDone << "." << endl;
+  bootClusters.finish(NbootsDone);
+  
   /////////// Confidence analysis /////////////////////
   
   cout << endl << "Confidence analysis" << endl;
   
   vector<bool> significantVec = vector<bool>(Nnode);
-  findConfCore(treeMap,bootClusters,significantVec,conf,R);
+  findConfCore(treeMap,bootClusters,significantVec,conf,&conf_R,false);
   vector<pair<int,int> > mergers;
-  findConfModules(treeMap,bootClusters,significantVec,mergers,conf);
+  findConfModules(treeMap,bootClusters,significantVec,mergers,conf,false);
   
   // Print significance map in .smap format for the Map Generator at www.mapequation.org
   
@@ -262,23 +412,29 @@ int main(int argc,char *argv[]){
     outfile << it->second.first << " " << it->second.second << " " << 1.0*it->first << endl;
   outfile.close();
   
+  perfPrint(cout);
+  allocPrint(cout);
+  
   for(int i=0;i<greedy->Nnode;i++){
     delete node[i];
   }
   delete [] node;
   delete greedy;
+  delete ckp;
   delete R;
   
 }
 
-void partition(MTRand *R,Node ***node, GreedyBase *greedy, bool silent){
+void partition(Random *R,Node ***node, GreedyBase *greedy, bool silent){
   
   int Nnode = greedy->Nnode;
+  perfBegin(PERF_COPY);
   Node **cpy_node = new Node*[Nnode];
   for(int i=0;i<Nnode;i++){
     cpy_node[i] = new Node();
     cpyNode(cpy_node[i],(*node)[i]);
   }
+  perfEnd(PERF_COPY);
   
   int iteration = 0;
   double outer_oldCodeLength;
@@ -287,15 +443,18 @@ void partition(MTRand *R,Node ***node, GreedyBase *greedy, bool silent){
     
     if((iteration > 0) && (iteration % 2 == 0) && (greedy->Nnode > 1)){  // Partition the partition
       
+      PerfRegion region(PERF_SUBMODULE);
       
       if(!silent)
         cout << "Iteration " << iteration+1 << ", moving " << flush;
       
+      perfBegin(PERF_COPY);
       Node **rpt_node = new Node*[Nnode];
       for(int i=0;i<Nnode;i++){
         rpt_node[i] = new Node();
         cpyNode(rpt_node[i],cpy_node[i]);
       }
+      perfEnd(PERF_COPY);
       vector<int> subMoveTo(Nnode);
       vector<int> moveTo(Nnode);
       int subModIndex = 0;
@@ -307,40 +466,15 @@ void partition(MTRand *R,Node ***node, GreedyBase *greedy, bool silent){
         if(sub_Nnode > 1){
           
           Node **sub_node = new Node*[sub_Nnode]; 
-          set<int> sub_mem;
-          for(int j=0;j<sub_Nnode;j++)
-            sub_mem.insert((*node)[i]->members[j]);
-          set<int>::iterator it_mem = sub_mem.begin();
-          int *sub_renumber = new int[Nnode];
-          int *sub_rev_renumber = new int[sub_Nnode];
-          double totalDegree = 0.0;
-          for(int j=0;j<sub_Nnode;j++){
-            
-            //    fprintf(stderr,"%d %d\n",j,(*it_mem));
-            int orig_nr = (*it_mem);
-            int orig_Nlinks = cpy_node[orig_nr]->links.size(); // ERROR HERE
-            sub_renumber[orig_nr] = j;
-            sub_rev_renumber[j] = orig_nr;
-            sub_node[j] = new Node(j);
-            for(int k=0;k<orig_Nlinks;k++){
-              int orig_link = cpy_node[orig_nr]->links[k].first;
-              int orig_link_newnr = sub_renumber[orig_link];
-              double orig_weight = cpy_node[orig_nr]->links[k].second;
-              if(orig_link < orig_nr){
-                if(sub_mem.find(orig_link) != sub_mem.end()){
-                  sub_node[j]->links.push_back(make_pair(orig_link_newnr,orig_weight));
-                  sub_node[orig_link_newnr]->links.push_back(make_pair(j,orig_weight));
-                  totalDegree += 2.0*orig_weight;
-                }
-              }
-            }
-            it_mem++;
-          }
+          vector<int> sub_rev_renumber((*node)[i]->members);
+          sort(sub_rev_renumber.begin(),sub_rev_renumber.end());
+          double totalDegree = extractSubNet(cpy_node,Nnode,sub_rev_renumber,sub_node);
           
+          Random sub_R = R->split(); // Own stream for each submodule
           GreedyBase* sub_greedy;
-          sub_greedy = new Greedy(R,sub_Nnode,totalDegree,sub_node);
+          sub_greedy = new Greedy(&sub_R,sub_Nnode,totalDegree,sub_node);
           sub_greedy->initiate();
-          partition(R,&sub_node,sub_greedy,true);
+          partition(&sub_R,&sub_node,sub_greedy,true);
           for(int j=0;j<sub_greedy->Nnode;j++){
             int Nmembers = sub_node[j]->members.size();
             for(int k=0;k<Nmembers;k++){
@@ -353,8 +487,6 @@ void partition(MTRand *R,Node ***node, GreedyBase *greedy, bool silent){
           
           delete [] sub_node;
           delete sub_greedy;
-          delete [] sub_renumber;
-          delete [] sub_rev_renumber;
           
         }
         else{
@@ -392,11 +524,13 @@ void partition(MTRand *R,Node ***node, GreedyBase *greedy, bool silent){
         cout << "Iteration " << iteration+1 << ", moving " << Nnode << " nodes, looping " << flush;
       
       
+      perfBegin(PERF_COPY);
       Node **rpt_node = new Node*[Nnode];
       for(int i=0;i<Nnode;i++){
         rpt_node[i] = new Node();
         cpyNode(rpt_node[i],cpy_node[i]);
       }
+      perfEnd(PERF_COPY);
       
       vector<int> moveTo(Nnode);
       for(int i=0;i<greedy->Nnode;i++){
@@ -430,20 +564,26 @@ void partition(MTRand *R,Node ***node, GreedyBase *greedy, bool silent){
       oldCodeLength = greedy->codeLength;
       bool moved = true;
       int Nloops = 0;
-      int count = 0;
+      vector<int> active; // Nodes to try in the next sweep
+      if(GreedyBase::activeSet){
+        active.resize(greedy->Nnode);
+        for(int i=0;i<greedy->Nnode;i++)
+          active[i] = i;
+      }
       while(moved){
         moved = false;
         double inner_oldCodeLength = greedy->codeLength;
-        greedy->move(moved);
+        if(GreedyBase::activeSet)
+          greedy->moveSet(active,moved);
+        else
+          greedy->move(moved);
         Nloops++;
-        count++;
-        if(fabs(inner_oldCodeLength-greedy->codeLength) < 1.0e-10)
+        if(fabs(inner_oldCodeLength-greedy->codeLength) < 1.0e-10 || (GreedyBase::activeSet && active.empty()))
           moved = false;
         
-        if(count == 10){	  
+        // Recompute the code length only when rounding may have changed it
+        if(greedy->drifted())
           greedy->tune();
-          count = 0;
-        }
         // 	if(!silent){
         // 	  cerr << Nloops;
         // 	  int loopsize = to_string(Nloops).length();
@@ -471,7 +611,7 @@ void partition(MTRand *R,Node ***node, GreedyBase *greedy, bool silent){
   
 }
 
-void repeated_partition(MTRand *R, Node ***node, GreedyBase *greedy, bool silent,int Ntrials){
+void repeated_partition(Random *R, Node ***node, GreedyBase *greedy, bool silent,int Ntrials,vector<int> &initCluster){
   
   double shortestCodeLength = 1000.0;
   int Nnode = greedy->Nnode;
@@ -482,18 +622,25 @@ void repeated_partition(MTRand *R, Node ***node, GreedyBase *greedy, bool silent
     if(!silent)
       cout << "Attempt " << trial+1 << "/" << Ntrials << endl;
     
+    perfBegin(PERF_COPY);
     Node **cpy_node = new Node*[Nnode];
     for(int i=0;i<Nnode;i++){
       cpy_node[i] = new Node();
       cpyNode(cpy_node[i],(*node)[i]);
     }
+    perfEnd(PERF_COPY);
     
     greedy->Nnode = Nnode;
     greedy->Nmod = Nnode;
     greedy->node = cpy_node;
     greedy->initiate();
+    // The first attempt starts from the initial partition, if any
+    if(trial == 0 && !initCluster.empty())
+      greedy->determMove(initCluster);
     
-    partition(R,&cpy_node,greedy,silent);
+    Random trial_R = R->split(trial); // Own stream for each trial
+    greedy->setRandom(&trial_R);
+    partition(&trial_R,&cpy_node,greedy,silent);
     
     if(greedy->codeLength < shortestCodeLength){
       
@@ -514,6 +661,8 @@ void repeated_partition(MTRand *R, Node ***node, GreedyBase *greedy, bool silent
     
   }
   
+  greedy->setRandom(R);
+  
   // Commit best partition
   greedy->Nnode = Nnode;
   greedy->Nmod = Nnode;
@@ -566,12 +715,14 @@ void printSignificantTree(string s,multimap<double,treeNode,greater<double> >::i
   }  
 }
 
-void findConfCore(multimap<double,treeNode,greater<double> > &treeMap,vector<vector<int > > &bootClusters,vector<bool> &significantVec,double conf,MTRand *R){
+void findConfCore(multimap<double,treeNode,greater<double> > &treeMap,BootClusterStore &bootClusters,vector<bool> &significantVec,double conf,Random *R,bool silent){
+  
+  PerfRegion region(PERF_SIGNIFICANCE);
   
-  int Nboots = bootClusters.size();
+  int Nboots = bootClusters.Nboots;
   int Nremove = static_cast<int>((1.0-conf)*Nboots+0.5);
   
-  int Nnode = bootClusters[0].size();
+  int Nnode = bootClusters.Nnode;
   vector<double> size = vector<double>(Nnode);
   
   int M = treeMap.size();
@@ -595,307 +746,36 @@ void findConfCore(multimap<double,treeNode,greater<double> > &treeMap,vector<vec
   }
   
   
-  cout << "MCMC to maximize confidence size of " << endl;
+  // Modules are searched independently, each with its own random stream
+  vector<vector<bool> > maxConfState = vector<vector<bool> >(M);
+  vector<double> maxConfSize = vector<double>(M);
+  vector<int> maxConfN = vector<int>(M);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
   for(int i=0;i<M;i++){
-    
-    cout << "module " << i+1 << ": " << flush;
-    
-    int N = modSortMembers[i].size();
-    vector<bool> confState = vector<bool>(N);
-    vector<bool> maxConfState = vector<bool>(N);
-    double maxScore = -1.0;
-    
-    double confSize = 0.0;
-    int confN = 0;
-    double maxConfSize = 0.0;
-    int maxConfN = 0;
-    double score = 0.0;
-    int penalty = 0;
-    
-    double pW = 10.0*moduleSize[i];
-    
-    if(N != 1){
-      
-      int maxModNr = 0;
-      for(int j=0;j<Nboots;j++)
-        for(int k=0;k<N;k++)
-          if(bootClusters[j][modSortMembers[i][k]] > maxModNr )
-            maxModNr = bootClusters[j][modSortMembers[i][k]];
-      maxModNr++;
-      
-      // Initiate weights of module assignments
-      
-      // Keep track of the size order of modules
-      vector<multimap<double,int,greater<double> > > sortModSizes = vector<multimap<double,int,greater<double> > >(Nboots);
-      // Keep track of which modules that are included
-      vector<vector<pair<int,multimap<double,int,greater<double> >::iterator > > > mapModSizes = vector<vector<pair<int,multimap<double,int,greater<double> >::iterator > > >(Nboots);
-      for(int j=0;j<Nboots;j++){
-        mapModSizes[j] = vector<pair<int,multimap<double,int,greater<double> >::iterator > >(maxModNr);
-        for(int k=0;k<maxModNr;k++){
-          mapModSizes[j][k].first = 0;
-        }
-      }
-      
-      // Randomized start
-      for(int j=0;j<N;j++){
-        if(R->randInt() << 31){
-          confState[j] = true;
-          confSize += size[modSortMembers[i][j]];
-          confN++;
-          
-          for(int k=0;k<Nboots;k++){
-            
-            int modNr = bootClusters[k][modSortMembers[i][j]];
-            if(mapModSizes[k][modNr].first == 0){
-              double newSize = size[modSortMembers[i][j]];
-              multimap<double,int,greater<double> >::iterator it = sortModSizes[k].insert(make_pair(newSize,modNr));
-              mapModSizes[k][modNr].second = it;
-              mapModSizes[k][modNr].first++;
-            }
-            else{
-              double newSize = size[modSortMembers[i][j]] + mapModSizes[k][modNr].second->first;
-              multimap<double,int,greater<double> >::iterator it = sortModSizes[k].insert(mapModSizes[k][modNr].second,make_pair(newSize,modNr));
-              sortModSizes[k].erase(mapModSizes[k][modNr].second);
-              mapModSizes[k][modNr].second = it;
-              mapModSizes[k][modNr].first++;
-            }
-            
-          }
-        }
-        else
-          confState[j] = false;
-      }
-      
-      multimap<double,pair<int,int> > scoreRank;
-      score = 0.0;
-      // Calculate penalty
-      for(int j=0;j<Nboots;j++){
-				double tmpScore = 0.0;
-				int tmpPenalty = 0;
-				if(!sortModSizes[j].empty()){
-        		int modNr = sortModSizes[j].begin()->second; 
-         		tmpScore = sortModSizes[j].begin()->first;
-						tmpPenalty = confN - mapModSizes[j][modNr].first; //penalty is the number of nodes not in biggest field
-				}
-        scoreRank.insert(make_pair(tmpScore-pW*tmpPenalty,make_pair(tmpPenalty,j)));
-        score += tmpScore;
-        penalty += tmpPenalty;
-      }
-      
-      // Remove worst results
-      multimap<double,pair<int,int> >::iterator it = scoreRank.begin();
-      for(int j=0;j<Nremove;j++){
-        int bootNr = it->second.second;
-				double tmpScore = 0.0;
-				int tmpPenalty = 0;
-				if(!sortModSizes[bootNr].empty()){
-        	tmpScore = sortModSizes[bootNr].begin()->first;
-        	tmpPenalty = it->second.first;
-				}
-        score -= tmpScore;
-        penalty -= tmpPenalty;
-        it++;
-      }
-      
-      
-      //Monte Carlo to maximize confident size
-      int Niter = static_cast<int>(pow(1.0*N,1.0));
-      if(Niter < 100)
-        Niter = 100;
-      int attempts = 0;
-      int switches = 0;
-      bool search = true;
-      while(search){
-        
-        double T = 1.0;
-        
-        do{
-          
-          attempts = 0;
-          switches = 0;
-          for(int j=0;j<Niter;j++){
-            
-            multimap<double,pair<int,int> >().swap(scoreRank);
-            double newConfSize = confSize;
-            int newConfN = confN;
-            double newScore = 0.0;
-            int newPenalty = 0;
-            
-            int flip = R->randInt(N-1);
-            int nodeNr = modSortMembers[i][flip];
-            
-            if(confState[flip]){ // Remove one node from confident subset
-              newConfSize -= size[nodeNr];
-              newConfN--;
-              for(int k=0;k<Nboots;k++){
-                int modNr = bootClusters[k][nodeNr];
-                double tmpScore = sortModSizes[k].begin()->first;
-                int tmpPenalty = newConfN - mapModSizes[k][sortModSizes[k].begin()->second].first;
-                if(mapModSizes[k][modNr].second == sortModSizes[k].begin()){
-                  tmpScore -= size[nodeNr];
-                  tmpPenalty = newConfN - (mapModSizes[k][modNr].first-1);
-                  if(sortModSizes[k].size() > 1){ 
-                    multimap<double,int,greater<double> >::iterator it = sortModSizes[k].begin();
-                    it++;
-                    if(it->first > tmpScore){ // Check if second in ranking is larger
-                      tmpScore = it->first;
-                      tmpPenalty = newConfN - mapModSizes[k][it->second].first;
-                    }
-                  }
-                }
-                scoreRank.insert(make_pair(tmpScore-pW*tmpPenalty,make_pair(tmpPenalty,k)));
-                newScore += tmpScore;
-                newPenalty += tmpPenalty;
-              }
-            }
-            else{ // Add one node to confident subset
-              newConfSize += size[nodeNr];
-              newConfN++;
-              for(int k=0;k<Nboots;k++){
-                
-                int modNr = bootClusters[k][nodeNr];
-                double tmpScore = 0.0;
-                int tmpPenalty = 0;
-                if(sortModSizes[k].empty()){ // No nodes in confident subset
-                  tmpScore = size[nodeNr];
-                  tmpPenalty = 0;
-                }
-                else{
-                  
-                  if(mapModSizes[k][modNr].first == 0){ // First confident node in module
-                    if(size[nodeNr] > sortModSizes[k].begin()->first){
-                      tmpScore = size[nodeNr];
-                      tmpPenalty = newConfN - 1;
-                    }
-                    else{
-                      tmpScore = sortModSizes[k].begin()->first;
-                      tmpPenalty = newConfN - mapModSizes[k][sortModSizes[k].begin()->second].first;
-                    }
-                  }
-                  else{ // Not first confident node in module
-                    
-                    if(mapModSizes[k][modNr].second == sortModSizes[k].begin()){
-                      tmpScore = sortModSizes[k].begin()->first + size[nodeNr];
-                      tmpPenalty = newConfN - (mapModSizes[k][sortModSizes[k].begin()->second].first+1);
-                    }
-                    else{
-                      
-                      if(mapModSizes[k][modNr].second->first + size[nodeNr] > sortModSizes[k].begin()->first){
-                        tmpScore = mapModSizes[k][modNr].second->first + size[nodeNr];
-                        tmpPenalty = newConfN - (mapModSizes[k][modNr].first+1);
-                      }
-                      else{
-                        tmpScore = sortModSizes[k].begin()->first;
-                        tmpPenalty = newConfN - mapModSizes[k][sortModSizes[k].begin()->second].first;
-                      }
-                      
-                    }
-                    
-                  }
-                }
-                
-                scoreRank.insert(make_pair(tmpScore-pW*tmpPenalty,make_pair(tmpPenalty,k)));
-                newScore += tmpScore;
-                newPenalty += tmpPenalty;
-              }
-            }
-            
-            // Remove worst results
-            multimap<double,pair<int,int> >::iterator it = scoreRank.begin();
-            for(int j=0;j<Nremove;j++){
-              int bootNr = it->second.second;
-              if(!sortModSizes[bootNr].empty()){
-                double tmpScore = sortModSizes[bootNr].begin()->first;
-                int tmpPenalty = it->second.first;
-                newScore -= tmpScore;
-                newPenalty -= tmpPenalty;
-              }
-               
-              it++;
-            }
-            
-            if(exp(((newScore-pW*newPenalty)-(score-pW*penalty))/T) > R->rand()){
-              
-              // Update data structures
-              if(confState[flip]){ // Remove one node from confident subset
-                
-                for(int k=0;k<Nboots;k++){
-                  int modNr = bootClusters[k][nodeNr];
-                  mapModSizes[k][modNr].first--;
-                  if(mapModSizes[k][modNr].first == 0){ // Remove last confident node from module
-                    sortModSizes[k].erase(mapModSizes[k][modNr].second);
-                  }
-                  else{
-                    double newSize = mapModSizes[k][modNr].second->first - size[nodeNr];
-                    multimap<double,int,greater<double> >::iterator it = sortModSizes[k].insert(mapModSizes[k][modNr].second,make_pair(newSize,modNr));
-                    sortModSizes[k].erase(mapModSizes[k][modNr].second);
-                    mapModSizes[k][modNr].second = it;
-                  }
-                  
-                }
-              }
-              else{ // Add one node from confident subset
-                
-                for(int k=0;k<Nboots;k++){
-                  
-                  int modNr = bootClusters[k][nodeNr];
-                  if(mapModSizes[k][modNr].first == 0){
-                    double newSize = size[nodeNr];
-                    multimap<double,int,greater<double> >::iterator it = sortModSizes[k].insert(make_pair(newSize,modNr));
-                    mapModSizes[k][modNr].second = it;
-                    mapModSizes[k][modNr].first++;
-                  }
-                  else{
-                    double newSize = size[nodeNr] + mapModSizes[k][modNr].second->first;
-                    multimap<double,int,greater<double> >::iterator it = sortModSizes[k].insert(mapModSizes[k][modNr].second,make_pair(newSize,modNr));
-                    sortModSizes[k].erase(mapModSizes[k][modNr].second);
-                    mapModSizes[k][modNr].second = it;
-                    mapModSizes[k][modNr].first++;
-                  }
-                  
-                }
-                
-              }
-              
-              confSize = newConfSize;
-              confN = newConfN;
-              confState[flip] = !confState[flip];
-              penalty = newPenalty;
-              score = newScore;
-              switches++;
-            }
-            attempts++;
-            
-            if(penalty == 0 && score > maxScore){
-              for(int k=0;k<N;k++)
-                maxConfState[k] = confState[k];
-              maxScore = score;
-              maxConfSize = confSize;
-              maxConfN = confN;
-            }
-            
-          }
-          T *= 0.99;
-          //cout << T << " " <<  1.0*switches/attempts << " " << score << " " << penalty << "    " << confSize << " " << confN << endl;
-        } while(switches > 0);
-        
-        if(maxScore > 0.0)
-          search = false;
-        
-      }
-      
-    }
-    else{
-      maxConfState[0] = true;
-      maxConfSize = moduleSize[i];
-      maxConfN = 1;
+    Random module_R = R->split(i);
+    if(static_cast<double>(modSortMembers[i].size())*bootClusters.Nboots > CONFCORE_LARGE){
+      // Only one large module at a time holds the bootstrap modules of its members
+#ifdef _OPENMP
+#pragma omp critical(largeConfCore)
+#endif
+      findModuleCore(modSortMembers[i],size,moduleSize[i],bootClusters,Nremove,module_R,maxConfState[i],maxConfSize[i],maxConfN[i]);
     }
+    else
+      findModuleCore(modSortMembers[i],size,moduleSize[i],bootClusters,Nremove,module_R,maxConfState[i],maxConfSize[i],maxConfN[i]);
+  }
+  
+  if(!silent)
+    cout << "MCMC to maximize confidence size of " << endl;
+  for(int i=0;i<M;i++){
     
-    
-    cout << maxConfN << "/" << N << " confident nodes and " << maxConfSize << "/" << moduleSize[i] << " (" << 100*maxConfSize/moduleSize[i] << " percent) of the flow." << endl;
+    int N = modSortMembers[i].size();
+    if(!silent)
+      cout << "module " << i+1 << ": " << maxConfN[i] << "/" << N << " confident nodes and " << maxConfSize[i] << "/" << moduleSize[i] << " (" << 100*maxConfSize[i]/moduleSize[i] << " percent) of the flow." << endl;
     
     for(int j=0;j<N;j++)
-      significantVec[modSortMembers[i][j]] = maxConfState[j];
+      significantVec[modSortMembers[i][j]] = maxConfState[i][j];
     
   }
   
@@ -911,12 +791,14 @@ void findConfCore(multimap<double,treeNode,greater<double> > &treeMap,vector<vec
   
 }
 
-void findConfModules(multimap<double,treeNode,greater<double> > &treeMap,vector<vector<int > > &bootClusters,vector<bool> &significantVec,vector<pair<int,int> > &mergers,double conf){
+void findConfModules(multimap<double,treeNode,greater<double> > &treeMap,BootClusterStore &bootClusters,vector<bool> &significantVec,vector<pair<int,int> > &mergers,double conf,bool silent){
+  
+  PerfRegion region(PERF_SIGNIFICANCE);
   
   
   int M = treeMap.size();
-  int N = bootClusters[0].size();
-  int Nboots = bootClusters.size();
+  int N = bootClusters.Nnode;
+  int Nboots = bootClusters.Nboots;
   
   // Calculate total size of confident journals in field
   vector<vector<int> > significantNodes = vector<vector<int> >(N);
@@ -934,102 +816,29 @@ void findConfModules(multimap<double,treeNode,greater<double> > &treeMap,vector<
   }
   
   vector<vector<int> > coexistCount = vector<vector<int> >(M);
-  for(int i=0;i<M;i++)
-    coexistCount[i] = vector<int>(Nboots,0);
   
-  cout << endl << "Now calculate number of times two modules are clustered together" << endl;
-  int i=0;
-  for(multimap<double,treeNode,greater<double> >::iterator it1 = treeMap.begin();  it1 != treeMap.end(); it1++){ // i
-    int j=i;
-    for(multimap<double,treeNode,greater<double> >::iterator it2 = it1;  it2 != treeMap.end(); it2++){ // j
-            
-      if(it1 != it2){
-        
-        int coEx = 0;
-        for(int k=0;k<Nboots;k++){
-          int modNr = bootClusters[k][significantNodes[j][0]];
-          bool joined = true;
-          int iNnode = significantNodes[i].size();
-          int jNnode = significantNodes[j].size();
-          
-          for(int l=0;l<jNnode;l++){
-            if(bootClusters[k][significantNodes[j][l]] != modNr){
-              joined = false;
-              break;
-            }
-          }
-          
-          if(joined){
-            for(int l=0;l<iNnode;l++){
-              if(bootClusters[k][significantNodes[i][l]] != modNr){
-                joined = false;
-                break;
-              }
-            }
-          }
-          
-          if(joined){
-            coEx++;
-            coexistCount[i][k]++;
-            coexistCount[j][k]++;
-            
-            multimap<int,pair<int,vector<int> >,greater<int> >::iterator it = coExist[i].find(j);
-            if(it != coExist[i].end()){
-              it->second.first++;
-              it->second.second.push_back(k);
-            }
-            else{
-              vector<int> tmp;
-              tmp.push_back(k);
-              coExist[i].insert(make_pair(j,make_pair(1,tmp)));
-            }
-            it = coExist[j].find(i);
-            if(it != coExist[j].end()){
-              it->second.first++;
-              it->second.second.push_back(k);
-            }
-            else{
-              vector<int> tmp;
-              tmp.push_back(k);
-              it = coExist[j].insert(make_pair(i,make_pair(1,tmp)));
-            }
-          }
-          
-        }
-        
-        
-      }
-      
-      j++;
-    }
-    
-    // Re-sort co-exist strcuture
-    multimap<int,pair<int,vector<int> >,greater<int> > tmp = coExist[i];
-    multimap<int,pair<int,vector<int> >,greater<int> >().swap(coExist[i]);
-    for(multimap<int,pair<int,vector<int> >,greater<int> >::iterator it = tmp.begin(); it != tmp.end(); it++){
-      coExist[i].insert(make_pair(it->second.first,make_pair(it->first,it->second.second)));
-    }
-    
-    i++;
-    
-  }
+  if(!silent)
+    cout << endl << "Now calculate number of times two modules are clustered together" << endl;
+  coClusterModules(M,significantNodes,bootClusters,coexistCount,coExist);
   
   vector<int> mergeVec = vector<int>(M);
-  i=0;
+  int i=0;
   for(multimap<double,treeNode,greater<double> >::iterator it1 = treeMap.begin();  it1 != treeMap.end(); it1++){
     int singleN = 0;
     for(int k=0;k<Nboots;k++)
       if(coexistCount[i][k] == 0)
         singleN++;
-    cout << "Module " << i+1 << " is standalone " << singleN << "/" << Nboots << " times";
-    if(singleN == Nboots){
-      cout << "." << endl;
-    }
-    else{
-      cout << " and clustered together with: ";
-      for(multimap<int,pair<int,vector<int> >,greater<int> >::iterator it2 = coExist[i].begin(); it2 != coExist[i].end(); it2++)
-        cout << it2->second.first+1 << " (" << it2->first << "), ";
-      cout << endl;
+    if(!silent){
+      cout << "Module " << i+1 << " is standalone " << singleN << "/" << Nboots << " times";
+      if(singleN == Nboots){
+        cout << "." << endl;
+      }
+      else{
+        cout << " and clustered together with: ";
+        for(multimap<int,pair<int,vector<int> >,greater<int> >::iterator it2 = coExist[i].begin(); it2 != coExist[i].end(); it2++)
+          cout << it2->second.first+1 << " (" << it2->first << "), ";
+        cout << endl;
+      }
     }
     i++;
   }
@@ -1074,6 +883,8 @@ void findConfModules(multimap<double,treeNode,greater<double> > &treeMap,vector<
     }
   }
 
+  if(silent)
+    return;
   if(mergers.size() > 0){
     cout << endl << "Module associations of modules that are not significantly standalone:" << endl;
     
@@ -1086,4 +897,31 @@ void findConfModules(multimap<double,treeNode,greater<double> > &treeMap,vector<
   
 }
 
-
+// Significance with the first Nboots bootstrap networks, compared with the
+// previous call. Stable when at most a fraction tolerance of the nodes changed
+// significance and the module associations are the same. Every call draws
+// from the same streams as the final analysis.
+bool significanceStable(multimap<double,treeNode,greater<double> > &treeMap,BootClusterStore &bootClusters,int Nboots,double conf,Random *R,double tolerance,vector<bool> &lastSignificant,vector<pair<int,int> > &lastMergers){
+  
+  bootClusters.finish(Nboots);
+  int Nnode = bootClusters.Nnode;
+  vector<bool> significantVec = vector<bool>(Nnode);
+  findConfCore(treeMap,bootClusters,significantVec,conf,R,true);
+  vector<pair<int,int> > mergers;
+  findConfModules(treeMap,bootClusters,significantVec,mergers,conf,true);
+  
+  bool stable = false;
+  if(!lastSignificant.empty()){
+    int Nchanged = 0;
+    for(int i=0;i<Nnode;i++)
+      if(significantVec[i] != lastSignificant[i])
+        Nchanged++;
+    bool sameMergers = (mergers == lastMergers);
+    stable = sameMergers && Nchanged <= tolerance*Nnode;
+    cout << endl << "Significance with " << Nboots << " bootstrap networks: " << Nchanged << " node(s) changed significance and the module associations are " << (sameMergers ? "the same." : "different.") << endl;
+  }
+  lastSignificant.swap(significantVec);
+  lastMergers.swap(mergers);
+  return stable;
+  
+}
@@ -0,0 +1,14 @@
+#ifndef ALLOCTRACKER_H
+#define ALLOCTRACKER_H
+
+#include <iostream>
+using namespace std;
+
+// Count heap allocations per phase (see PerfCounters.h) through the global 
+// operator new and delete, false if the allocator cannot report block sizes.
+// Blocks allocated before the call are not counted, and freeing them later
+// can make the live bytes, and so the peaks, slightly low.
+bool allocEnable(void);
+void allocPrint(ostream &out);
+
+#endif
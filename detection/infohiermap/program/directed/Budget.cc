@@ -0,0 +1,58 @@
+#include "Budget.h"
+#include <iostream>
+#include <sys/time.h>
+using namespace std;
+
+static double budgetTime = 0.0; // Seconds, 0 for no limit
+static int budgetPatience = 0;  // Attempts, 0 for no limit
+static double budgetStart;
+static bool budgetOver = false;
+
+static double wallTime(void){
+  struct timeval tv;
+  gettimeofday(&tv,NULL);
+  return tv.tv_sec + 1.0e-6*tv.tv_usec;
+}
+
+void budgetSetTime(double seconds){
+  budgetTime = seconds;
+  budgetStart = wallTime();
+}
+
+void budgetSetPatience(int attempts){
+  budgetPatience = attempts;
+}
+
+bool budgetLimited(void){
+  return budgetTime > 0.0 || budgetPatience > 0;
+}
+
+bool budgetSpent(void){
+
+  if(budgetTime <= 0.0)
+    return false;
+  if(!budgetOver)
+    budgetOver = (wallTime() - budgetStart >= budgetTime);
+  return budgetOver;
+
+}
+
+bool budgetNextTrial(int trial,int Ntrials,int Nstale,bool silent){
+
+  if(Ntrials > 0 && trial >= Ntrials)
+    return false;
+  if(trial == 0)
+    return true;
+  if(budgetSpent()){
+    if(!silent)
+      cout << "Time budget of " << budgetTime << " s spent after " << trial << " attempt(s)." << endl;
+    return false;
+  }
+  if(budgetPatience > 0 && Nstale >= budgetPatience){
+    if(!silent)
+      cout << "No improvement in the last " << Nstale << " attempts, stopping after " << trial << " attempt(s)." << endl;
+    return false;
+  }
+  return true;
+
+}
@@ -0,0 +1,16 @@
+#ifndef BUDGET_H
+#define BUDGET_H
+
+// Stopping rules for the repeated partition attempts: a wall-clock budget for
+// the whole run and a patience in attempts without improvement. When the time
+// budget is spent, the running attempt stops at its next sweep and the best
+// partition found so far is returned.
+void budgetSetTime(double seconds);
+void budgetSetPatience(int attempts);
+bool budgetLimited(void);
+bool budgetSpent(void);
+// Whether to start attempt trial (from 0) of at most Ntrials (0 for no limit),
+// Nstale attempts after the last improvement
+bool budgetNextTrial(int trial,int Ntrials,int Nstale,bool silent);
+
+#endif
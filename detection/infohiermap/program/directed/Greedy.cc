@@ -1,11 +1,14 @@
 #include "Greedy.h"
+#include "PerfCounters.h"
 #define plogp( x ) ( (x) > 0.0 ? (x)*log(x) : 0.0 )
 
+LinkOrder GreedyBase::linkOrder = LINKS_SHUFFLE;
+
 Greedy::~Greedy(){	
   vector<int>().swap(modSnode);
 }
 
-Greedy::Greedy(MTRand *RR,int nnode,Node **ah, bool initrun){
+Greedy::Greedy(Random *RR,int nnode,Node **ah, bool initrun){
   
   R = RR;
   Nnode = nnode;  
@@ -21,16 +24,13 @@ Greedy::Greedy(MTRand *RR,int nnode,Node **ah, bool initrun){
 
 void Greedy::move(bool &moved){
   
+  PerfRegion region(PERF_MOVE);
+  
   // Generate random enumeration of nodes
   vector<int> randomOrder(Nnode);
   for(int i=0;i<Nnode;i++)
     randomOrder[i] = i;
-  for(int i=0;i<Nnode-1;i++){
-    int randPos = i + R->randInt(Nnode-i-1);
-    int tmp = randomOrder[i];
-    randomOrder[i] = randomOrder[randPos];
-    randomOrder[randPos] = tmp;
-  }
+  R->shuffle(&randomOrder[0],Nnode);
   
   unsigned int offset = 1;    
   vector<unsigned int> redirect(Nnode,0);
@@ -114,19 +114,13 @@ void Greedy::move(bool &moved){
       }
     }
     
-    // Randomize link order for optimized search 
-    for(int j=0;j<NmodLinks-1;j++){
-      int randPos = j + R->randInt(NmodLinks-j-1);
-      int tmp_M = flowNtoM[j].first;
-      double tmp_outFlow = flowNtoM[j].second.first;
-      double tmp_inFlow = flowNtoM[j].second.second;
-      flowNtoM[j].first = flowNtoM[randPos].first;
-      flowNtoM[j].second.first = flowNtoM[randPos].second.first;
-      flowNtoM[j].second.second = flowNtoM[randPos].second.second;
-      flowNtoM[randPos].first = tmp_M;
-      flowNtoM[randPos].second.first = tmp_outFlow;
-      flowNtoM[randPos].second.second = tmp_inFlow;
-    }
+    // Randomize link order for optimized search
+    int start = 0;
+    int Nties = 1;
+    if(linkOrder == LINKS_SHUFFLE)
+      R->shuffle(&flowNtoM[0],NmodLinks);
+    else if(linkOrder == LINKS_ROTATE && NmodLinks > 1)
+      start = R->randBelow(NmodLinks);
     
     int bestM = oldM;
     double best_outFlow = 0.0;
@@ -134,7 +128,10 @@ void Greedy::move(bool &moved){
     double best_delta = 0.0;
     
     // Find the move that minimizes the description length
-    for (int j=0; j<NmodLinks; j++) {
+    for (int l=0; l<NmodLinks; l++) {
+      int j = l + start;
+      if(j >= NmodLinks)
+        j -= NmodLinks;
       
       int newM = flowNtoM[j].first;
       double outFlowNewM = flowNtoM[j].second.first;
@@ -156,7 +153,15 @@ void Greedy::move(bool &moved){
         
         double deltaL = delta_enter - delta_enter_log_enter - delta_exit_log_exit + delta_size_log_size;
         
-        if(deltaL < best_delta){
+        bool better = deltaL < best_delta;
+        if(linkOrder == LINKS_TIEBREAK){
+          // Pick uniformly among equally good moves
+          if(better)
+            Nties = 1;
+          else if(deltaL == best_delta && bestM != oldM)
+            better = (R->randBelow(++Nties) == 0);
+        }
+        if(better){
           bestM = newM;
           best_outFlow = outFlowNewM;
           best_inFlow = inFlowNewM;
@@ -447,6 +452,8 @@ void Greedy::prepare(bool sort){
 
 void Greedy::level(Node ***node_tmp, bool sort){
   
+  PerfRegion region(PERF_LEVEL);
+  
   prepare(sort);
   
   //Node ***ntmp = node_tmp;
@@ -462,6 +469,7 @@ void Greedy::level(Node ***node_tmp, bool sort){
     (*node_tmp)[i]->exit = mod_exit[modSnode[i]];
     (*node_tmp)[i]->size = mod_size[modSnode[i]];
     (*node_tmp)[i]->outFlow = mod_outFlow[modSnode[i]];
+    (*node_tmp)[i]->teleportWeight = 0.0;
     nodeInMod[modSnode[i]] = i;
   }
   
@@ -474,6 +482,7 @@ void Greedy::level(Node ***node_tmp, bool sort){
     int i_M = nodeInMod[node[i]->index];
     
     copy(node[i]->members.begin(),node[i]->members.end(),back_inserter((*node_tmp)[i_M]->members));
+    (*node_tmp)[i_M]->teleportWeight += node[i]->teleportWeight;
     
     int NoutLinks = node[i]->outLinks.size(); 
     for(int j=0;j<NoutLinks;j++){
@@ -631,6 +640,8 @@ void Greedy::determMove(vector<int> &moveTo){
 
 void Greedy::eigenvector(void){
   
+  PerfRegion region(PERF_EIGENVECTOR);
+  
   vector<double> size_tmp = vector<double>(Nnode,1.0/Nnode);
   int Niterations = 0;
   double sqdiff = 1.0;
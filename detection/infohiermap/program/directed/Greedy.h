@@ -1,9 +1,10 @@
 #ifndef GREEDY_H
 #define GREEDY_H
-#include "MersenneTwister.h"
+#include "Random.h"
 #include "GreedyBase.h"
 #include "Node.h"
 #include <cmath>
+#include <climits>
 #include <iostream>
 #include <vector>
 #include <set>
@@ -14,7 +15,7 @@ using namespace std;
 
 class Greedy : public GreedyBase{
  public:
-  Greedy(MTRand *RR,int nnode,Node **ah, bool initrun);
+  Greedy(Random *RR,int nnode,Node **ah, bool initrun);
   virtual ~Greedy();
   virtual void initiate(void);
   virtual void calibrate(void);
@@ -0,0 +1,20 @@
+#ifndef SUBNET_H
+#define SUBNET_H
+
+#include <vector>
+#include "Node.h"
+using namespace std;
+
+// Subnetwork induced by members, original node numbers below Nnode in
+// increasing order: member j becomes sub_node[j] with its teleportation
+// weight, its self-link and the links among the members in the order of the
+// original links. With exits, sub_node[j] also gets the size of member j and
+// as outFlow the weight of its out-links that leave the members. Returns the
+// total weight of the out-links that leave the members, 0 without exits.
+// The local number of every member is kept in one dense array over the
+// original nodes, tagged with the number of the extraction, so an extraction
+// clears nothing and finds a member with one lookup. The array is shared, so
+// extractions must not run concurrently.
+double extractSubNet(Node **orig_node,int Nnode,vector<int> &members,Node **sub_node,bool exits);
+
+#endif
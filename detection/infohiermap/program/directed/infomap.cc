@@ -9,31 +9,91 @@ unsigned stou(char *s){
   return strtoul(s,(char **)NULL,10);
 }
 
-double fast_hierarchical_partition(MTRand *R, Node **node, treeNode &map, int Nnode,double &twoLevelCodeLength, bool deep);
-double hierarchical_partition(MTRand *R, Node **node, treeNode &map, int Nnode, double recursive);
-double repeated_hierarchical_partition(string networkName,vector<double> &size, vector<string> &nodeNames, MTRand *R, Node **orig_node, treeNode &map, int Nnode, int Ntrials, double recursive, treeStats &stats);
-void repeated_partition(MTRand *R, Node ***node, GreedyBase *greedy, bool silent,int Ntrials);
-void partition(MTRand *R, Node ***node, GreedyBase *greedy, bool silent);
+double fast_hierarchical_partition(Random *R, Node **node, treeNode &map, int Nnode,double &twoLevelCodeLength, bool deep, vector<int> *initCluster);
+double hierarchical_partition(Random *R, Node **node, treeNode &map, int Nnode, double recursive);
+double repeated_hierarchical_partition(string networkName,vector<double> &size, vector<string> &nodeNames, Random *R, Node **orig_node, treeNode &map, int Nnode, int Ntrials, double recursive, treeStats &stats,vector<int> &initCluster);
+void repeated_partition(Random *R, Node ***node, GreedyBase *greedy, bool silent,int Ntrials);
+void partition(Random *R, Node ***node, GreedyBase *greedy, bool silent);
 
 // Call: trade <seed> <Ntries>
 int main(int argc,char *argv[]){
   
-  if(argc < 4 || argc > 5){
-    cout << "Call: ./infomap <seed> <network.net> <# attempts> <recursive[0-1]>" << endl;
+  // Options of the form --name follow the positional arguments
+  int Nargs = firstOption(argc,argv);
+  if(Nargs < 4 || Nargs > 5){
+    cout << "Call: ./infomap <seed> <network.net> <# attempts> <recursive[0-1]> [--perf] [--alloc-stats] [--link-order shuffle|rotate|tiebreak] [--time-budget seconds] [--patience K] [--init-partition file.clu] [--warm-only]" << endl;
     exit(-1);
   }
   
   int Ntrials = atoi(argv[3]);  // Set number of partition attempts
   double recursive = 0.0;
-  if(argc == 5)
+  if(Nargs == 5)
     recursive = atoi(argv[4]);
+  string initFile;
+  bool warmOnly = false;
+  for(int i=Nargs;i<argc;i++){
+    string option = to_string(argv[i]);
+    if(option == "--perf")
+      perfEnable();
+    else if(option == "--alloc-stats")
+      allocEnable();
+    else if(option == "--link-order" && i+1 < argc){
+      string order = to_string(argv[++i]);
+      if(order == "shuffle")
+        GreedyBase::linkOrder = LINKS_SHUFFLE;
+      else if(order == "rotate")
+        GreedyBase::linkOrder = LINKS_ROTATE;
+      else if(order == "tiebreak")
+        GreedyBase::linkOrder = LINKS_TIEBREAK;
+      else{
+        cout << "Unknown link order " << order << "...exiting" << endl;
+        exit(-1);
+      }
+    }
+    else if(option == "--time-budget" && i+1 < argc){
+      double seconds = atof(argv[++i]);
+      if(seconds <= 0.0){
+        cout << "The time budget must be positive...exiting" << endl;
+        exit(-1);
+      }
+      budgetSetTime(seconds);
+    }
+    else if(option == "--init-partition" && i+1 < argc)
+      initFile = string(argv[++i]);
+    else if(option == "--warm-only")
+      warmOnly = true;
+    else if(option == "--patience" && i+1 < argc){
+      int attempts = atoi(argv[++i]);
+      if(attempts <= 0){
+        cout << "The patience must be a positive number of attempts...exiting" << endl;
+        exit(-1);
+      }
+      budgetSetPatience(attempts);
+    }
+    else{
+      cout << "Unknown option " << option << "...exiting" << endl;
+      exit(-1);
+    }
+  }
+  if(warmOnly){
+    if(initFile.empty()){
+      cout << "--warm-only needs --init-partition...exiting" << endl;
+      exit(-1);
+    }
+    Ntrials = 1;
+  }
+  if(Ntrials == 0 && !budgetLimited()){
+    cout << "0 attempts (no limit) needs --time-budget or --patience...exiting" << endl;
+    exit(-1);
+  }
   string infile = string(argv[2]);
 
   string networkName(infile.begin(),infile.begin() + infile.find_last_of("."));
   string networkType(infile.begin() + infile.find_last_of("."),infile.end());
   
-  MTRand *R = new MTRand(stou(argv[1]));
+  Random *R = new Random(stou(argv[1]));
   
+  perfBegin(PERF_LOAD);
   Network network(argv[2]);
   
   if(networkType == ".net")
@@ -73,6 +133,7 @@ int main(int argc,char *argv[]){
   
   //Swap vector to free memory
   map<int,map<int,double> >().swap(network.Links);
+  perfEnd(PERF_LOAD);
   
   // Calculate size of nodes and flow between nodes
   GreedyBase* greedy;
@@ -90,10 +151,14 @@ int main(int argc,char *argv[]){
       uncompressedCodeLength -= p*log(p)/log(2.0);
   }
   
+  vector<int> initCluster;
+  if(!initFile.empty())
+    loadPartition(initFile,Nnode,initCluster);
+  
   // Partition network hierarchically
   treeNode map;
   treeStats stats;
-  double codeLength = repeated_hierarchical_partition(networkName,size,network.nodeNames,R,node,map,Nnode,Ntrials,recursive,stats);
+  double codeLength = repeated_hierarchical_partition(networkName,size,network.nodeNames,R,node,map,Nnode,Ntrials,recursive,stats,initCluster);
   
   cout << endl << "Best codelength = " << codeLength/log(2.0) << " bits." << endl;
   cout << "Compression: " << 100.0*(1.0-codeLength/uncompressedCodeLength) << " percent." << endl;
@@ -102,6 +167,8 @@ int main(int argc,char *argv[]){
   cout << "Average depth: " << stats.aveDepth << endl;
   cout << "Average size: " << stats.aveSize << endl;
   cout << "Gain over two-level code: " << 100.0*(stats.twoLevelCodeLength-codeLength)/codeLength << " percent." << endl;
+  perfPrint(cout);
+  allocPrint(cout);
   
   for(int i=0;i<Nnode;i++)
     delete node[i];
@@ -110,7 +177,7 @@ int main(int argc,char *argv[]){
   
 }
 
-double fast_hierarchical_partition(MTRand *R, Node **orig_node, treeNode &map, int Nnode, double &twoLevelCodeLength, bool deep){
+double fast_hierarchical_partition(Random *R, Node **orig_node, treeNode &map, int Nnode, double &twoLevelCodeLength, bool deep, vector<int> *initCluster){
   
   //MEMBERS FASTER WITH VECTOR?
   
@@ -128,9 +195,11 @@ double fast_hierarchical_partition(MTRand *R, Node **orig_node, treeNode &map, i
     return map.codeLength;
   }
   
-  // Store best map
+  // Best level so far. Only the code length and the subtrees of map change
+  // below, so they are kept aside by swapping instead of copying the tree
   double best_codeLength = map.codeLength;
-  treeNode best_map = map;
+  double best_indexLength = map.codeLength;
+  multimap<double,treeNode,greater<double> > best_nextLevel;
   
   // Initiate solver
   GreedyBase* sub_greedy;
@@ -142,13 +211,16 @@ double fast_hierarchical_partition(MTRand *R, Node **orig_node, treeNode &map, i
     vector<int> cluster = vector<int>(sub_Nnode);
     int sub_Nmod = 0;
     for(multimap<double,treeNode,greater<double> >::iterator subsub_it = map.nextLevel.begin(); subsub_it != map.nextLevel.end(); subsub_it++){
-      set<int> subsub_members = subsub_it->second.members;
+      set<int> &subsub_members = subsub_it->second.members;
       for(set<int>::iterator mem = subsub_members.begin(); mem != subsub_members.end(); mem++)
-        cluster[map.renumber[(*mem)]] = sub_Nmod;
+        cluster[lower_bound(map.rev_renumber.begin(),map.rev_renumber.end(),*mem) - map.rev_renumber.begin()] = sub_Nmod;
       sub_Nmod++;
     }
     sub_greedy->determMove(cluster);
   }
+  // Start the first attempt from the initial partition, if any
+  else if(initCluster != NULL)
+    sub_greedy->determMove(*initCluster);
   
   if(map.level == 1)
     cout << "Partition first level into..." << flush;
@@ -211,7 +283,6 @@ double fast_hierarchical_partition(MTRand *R, Node **orig_node, treeNode &map, i
     
     map.codeLength = subIndexLength;
     best_codeLength = subCodeLength;
-    best_map = map;
     
     if(!deep){
       
@@ -225,6 +296,10 @@ double fast_hierarchical_partition(MTRand *R, Node **orig_node, treeNode &map, i
       
     }
     
+    // The loop below rebuilds map.nextLevel from scratch
+    best_indexLength = map.codeLength;
+    best_nextLevel.swap(map.nextLevel);
+    
     double codeLength = map.codeLength;
     
     // Add index codebooks as long as the code gets shorter
@@ -283,8 +358,10 @@ double fast_hierarchical_partition(MTRand *R, Node **orig_node, treeNode &map, i
         // Create hierarchical tree under current level recursively 
         codeLength = sub_greedy->indexLength;
         
-        for(multimap<double,treeNode,greater<double> >::iterator it = map.nextLevel.begin(); it != map.nextLevel.end(); it++)
-          codeLength += fast_hierarchical_partition(R,orig_node,it->second,Nnode,twoLevelCodeLength,false);
+        for(multimap<double,treeNode,greater<double> >::iterator it = map.nextLevel.begin(); it != map.nextLevel.end(); it++){
+          Random sub_R = R->split(); // Own stream for each subtree
+          codeLength += fast_hierarchical_partition(&sub_R,orig_node,it->second,Nnode,twoLevelCodeLength,false,NULL);
+        }
         
         if(map.level == 1)
           cout << codeLength/log(2.0) << " bits." << endl;
@@ -294,7 +371,8 @@ double fast_hierarchical_partition(MTRand *R, Node **orig_node, treeNode &map, i
           map.codeLength = sub_greedy->indexLength;
           subIndexLength = sub_greedy->indexLength;
           best_codeLength = codeLength;
-          best_map = map;
+          best_indexLength = map.codeLength;
+          best_nextLevel.swap(map.nextLevel);
           
         }
         else{ // Longer code, restore best result and stop
@@ -320,15 +398,21 @@ double fast_hierarchical_partition(MTRand *R, Node **orig_node, treeNode &map, i
     delete sub_greedy;   
     
     // Restore best map
-    map = best_map;      
+    map.codeLength = best_indexLength;
+    map.nextLevel.swap(best_nextLevel);
     
   }
   
+  // Keep a copy to restore if the deeper levels do not help
+  perfBegin(PERF_HIERARCHY);
+  best_nextLevel = map.nextLevel;
+  perfEnd(PERF_HIERARCHY);
   
   // Create hierarchical tree under current level recursively 
   double codeLength = map.codeLength;
   for(multimap<double,treeNode,greater<double> >::iterator it = map.nextLevel.begin(); it != map.nextLevel.end(); it++){
-    codeLength += fast_hierarchical_partition(R,orig_node,it->second,Nnode,twoLevelCodeLength,true);
+    Random sub_R = R->split(); // Own stream for each subtree
+    codeLength += fast_hierarchical_partition(&sub_R,orig_node,it->second,Nnode,twoLevelCodeLength,true,NULL);
   }
   
   // Update best map if improvements
@@ -336,14 +420,15 @@ double fast_hierarchical_partition(MTRand *R, Node **orig_node, treeNode &map, i
     best_codeLength = codeLength;
   }
   else {
-    map = best_map;
+    map.codeLength = best_indexLength;
+    map.nextLevel.swap(best_nextLevel);
   }
   
   return best_codeLength;
   
 }
 
-double hierarchical_partition(MTRand *R, Node **orig_node, treeNode &map, int Nnode, double recursive){
+double hierarchical_partition(Random *R, Node **orig_node, treeNode &map, int Nnode, double recursive){
   
   //MEMBERS FASTER WITH VECTOR?
   
@@ -370,7 +455,9 @@ double hierarchical_partition(MTRand *R, Node **orig_node, treeNode &map, int Nn
     
     // Store best map
     double best_codeLength = map.codeLength;
+    perfBegin(PERF_HIERARCHY);
     treeNode best_map = map;
+    perfEnd(PERF_HIERARCHY);
     
     // Initiate solver
     GreedyBase* sub_greedy;
@@ -384,7 +471,7 @@ double hierarchical_partition(MTRand *R, Node **orig_node, treeNode &map, int Nn
       for(multimap<double,treeNode,greater<double> >::iterator subsub_it = map.nextLevel.begin(); subsub_it != map.nextLevel.end(); subsub_it++){
         set<int> subsub_members = subsub_it->second.members;
         for(set<int>::iterator mem = subsub_members.begin(); mem != subsub_members.end(); mem++)
-          cluster[map.renumber[(*mem)]] = sub_Nmod;
+          cluster[lower_bound(map.rev_renumber.begin(),map.rev_renumber.end(),*mem) - map.rev_renumber.begin()] = sub_Nmod;
         sub_Nmod++;
       }
       sub_greedy->determMove(cluster);
@@ -444,7 +531,9 @@ double hierarchical_partition(MTRand *R, Node **orig_node, treeNode &map, int Nn
       if(subCodeLength < best_codeLength - 1.0e-10) { // Improvement
         
         best_codeLength = subCodeLength;
+        perfBegin(PERF_HIERARCHY);
         best_map = map;
+        perfEnd(PERF_HIERARCHY);
         
       }
       
@@ -456,15 +545,16 @@ double hierarchical_partition(MTRand *R, Node **orig_node, treeNode &map, int Nn
         map.codeLength = subIndexLength;
         codeLength = subIndexLength;
         for(multimap<double,treeNode,greater<double> >::iterator it = map.nextLevel.begin(); it != map.nextLevel.end(); it++){
-          
-          codeLength += hierarchical_partition(R,orig_node,it->second,Nnode,recursive);
-          
+          Random sub_R = R->split(); // Own stream for each subtree
+          codeLength += hierarchical_partition(&sub_R,orig_node,it->second,Nnode,recursive);
         }
         
         // Update best map if improvements
         if(codeLength < best_codeLength){
           best_codeLength = codeLength;
+          perfBegin(PERF_HIERARCHY);
           best_map = map;
+          perfEnd(PERF_HIERARCHY);
         }
         
       }
@@ -518,13 +608,17 @@ double hierarchical_partition(MTRand *R, Node **orig_node, treeNode &map, int Nn
           // Create hierarchical tree under current level recursively 
           codeLength = sub_greedy->indexLength;
           
-          for(multimap<double,treeNode,greater<double> >::iterator it = map.nextLevel.begin(); it != map.nextLevel.end(); it++)
-            codeLength += hierarchical_partition(R,orig_node,it->second,Nnode,recursive);
+          for(multimap<double,treeNode,greater<double> >::iterator it = map.nextLevel.begin(); it != map.nextLevel.end(); it++){
+            Random sub_R = R->split(); // Own stream for each subtree
+            codeLength += hierarchical_partition(&sub_R,orig_node,it->second,Nnode,recursive);
+          }
           
           if(codeLength < best_codeLength - 1.0e-10) { // Improvement
             
             best_codeLength = codeLength;
+            perfBegin(PERF_HIERARCHY);
             best_map = map;
+            perfEnd(PERF_HIERARCHY);
             
           }
           else{ // Longer code, restore best result and stop
@@ -544,7 +638,9 @@ double hierarchical_partition(MTRand *R, Node **orig_node, treeNode &map, int Nn
       delete sub_greedy;   
       
       // Restore best map
+      perfBegin(PERF_HIERARCHY);
       map = best_map;      
+      perfEnd(PERF_HIERARCHY);
       
     }
     
@@ -554,7 +650,9 @@ double hierarchical_partition(MTRand *R, Node **orig_node, treeNode &map, int Nn
     
     if(best_codeLength < return_codeLength - 1.0e-10){
       // Save best map
+      perfBegin(PERF_HIERARCHY);
       return_map = best_map;
+      perfEnd(PERF_HIERARCHY);
       return_codeLength = best_codeLength;
       
     }
@@ -571,150 +669,164 @@ double hierarchical_partition(MTRand *R, Node **orig_node, treeNode &map, int Nn
     cout << endl;
   
   // Restore best map
+  perfBegin(PERF_HIERARCHY);
   map = return_map;
+  perfEnd(PERF_HIERARCHY);
   
   return return_codeLength;
   
 }
 
-double repeated_hierarchical_partition(string networkName,vector<double> &size, vector<string> &nodeNames, MTRand *R, Node **orig_node, treeNode &best_map, int Nnode,int Ntrials, double recursive, treeStats &stats){
+double repeated_hierarchical_partition(string networkName,vector<double> &size, vector<string> &nodeNames, Random *R, Node **orig_node, treeNode &best_map, int Nnode,int Ntrials, double recursive, treeStats &stats,vector<int> &initCluster){
   
   double shortestCodeLength = 1000.0;
   stats.twoLevelCodeLength = 1000.0;
   
-  for(int trial = 0; trial<Ntrials;trial++){
+  int Nstale = 0; // Attempts since the last improvement
+  for(int trial = 0; budgetNextTrial(trial,Ntrials,Nstale,false); trial++){
     
-    cout << "Attempt " << trial+1 << "/" << Ntrials << ":" << endl;
+    cout << "Attempt " << trial+1 << (Ntrials > 0 ? "/" + to_string(Ntrials) : string("")) << ":" << endl;
     treeNode map;
     map.level = 1;
     for(int i=0;i<Nnode;i++){
       map.members.insert(i);
     }
 //    double codeLength = hierarchical_partition(R,orig_node,map,Nnode,recursive);
-    double codeLength = fast_hierarchical_partition(R,orig_node,map,Nnode,stats.twoLevelCodeLength,true);
+    Random trial_R = R->split(trial); // Own stream for each trial
+    double codeLength = fast_hierarchical_partition(&trial_R,orig_node,map,Nnode,stats.twoLevelCodeLength,true,(trial == 0 && !initCluster.empty()) ? &initCluster : NULL);
    
     cout << "Code length = " << codeLength/log(2.0) << " bits." << endl;
     
+    if(codeLength < shortestCodeLength - 1.0e-10)
+      Nstale = 0;
+    else
+      Nstale++;
     if(codeLength < shortestCodeLength){
-      
       shortestCodeLength = codeLength;
-      best_map = map;
-      
-      //Print hierarchical partition
-      ostringstream oss;
-      oss << networkName << ".tree";
-      cout << "New best result. Writing hierarchy to " << networkName << ".tree ... " << flush; 
-      ofstream outfile;
-      outfile.open(oss.str().c_str());
-      outfile << "# Codelength = " << codeLength/log(2.0) << " bits." << endl;
-      string s;
-      int depth=1;
-      stats.aveDepth = 0.0;
-      stats.aveSize = 0.0;
-      stats.Nmodules = 0;
-      stats.NlargeModules = 0;
-      stats.largeModuleLimit = static_cast<int>(0.01*Nnode);
-      printTree(s,map,nodeNames,size,&outfile,depth,stats);
-      outfile.close();
-      stats.aveDepth /= 1.0*Nnode;
-			stats.aveSize /= 1.0*Nnode;
-      cout << "done!" << endl;
-      cout << "Average depth: " << stats.aveDepth << endl;
-      cout << "Average size: " << stats.aveSize << endl;
-      cout << "Number of modules: " << stats.Nmodules << endl;
-      cout << "Number of large modules (> 1 percent of total number of nodes): " << stats.NlargeModules << endl;
-      cout << "Gain over two-level code: " << 100.0*(stats.twoLevelCodeLength-codeLength)/codeLength << " percent." << endl;
-
-      
-//      addNodesToMap(map,size);
+      cout << "New best result." << endl;
+      best_map.swap(map); // The next attempt starts from a new map
+    }
+    
+  }
+  
+  // Only the best hierarchy is kept during the attempts and written at the end
+  if(!best_map.members.empty()){
+    
+    PerfRegion region(PERF_HIERARCHY);
+    
+    //Print hierarchical partition
+    ostringstream oss;
+    oss << networkName << ".tree";
+    cout << "Writing hierarchy to " << networkName << ".tree ... " << flush; 
+    ofstream outfile;
+    outfile.open(oss.str().c_str());
+    outfile << "# Codelength = " << shortestCodeLength/log(2.0) << " bits." << endl;
+    string s;
+    int depth=1;
+    stats.aveDepth = 0.0;
+    stats.aveSize = 0.0;
+    stats.Nmodules = 0;
+    stats.NlargeModules = 0;
+    stats.largeModuleLimit = static_cast<int>(0.01*Nnode);
+    printTree(s,best_map,nodeNames,size,&outfile,depth,stats);
+    outfile.close();
+    stats.aveDepth /= 1.0*Nnode;
+    stats.aveSize /= 1.0*Nnode;
+    cout << "done!" << endl;
+    cout << "Average depth: " << stats.aveDepth << endl;
+    cout << "Average size: " << stats.aveSize << endl;
+    cout << "Number of modules: " << stats.Nmodules << endl;
+    cout << "Number of large modules (> 1 percent of total number of nodes): " << stats.NlargeModules << endl;
+    cout << "Gain over two-level code: " << 100.0*(stats.twoLevelCodeLength-shortestCodeLength)/shortestCodeLength << " percent." << endl;
+    
+//    addNodesToMap(best_map,size);
+//    
+//    for(int level=0;level<=3;level++){ 
 //      
-//      for(int level=0;level<=3;level++){ 
-//        
-//        // Print map in .map format for the Map Generator at www.mapequation.org
-//        // Collapse to two levels
-//        multimap<double,printTreeNode,greater<double> > collapsedmap;
-//        collapseTree(collapsedmap,map,size,level);
-//        int Nmod = collapsedmap.size();
-//        vector<int> cluster(Nnode);
-//        int cluNr = 0;
-//        for(multimap<double,printTreeNode,greater<double> >::iterator it = collapsedmap.begin(); it != collapsedmap.end(); it++){
-//          it->second.rank = cluNr;
-//          for (multimap<double,int,greater<double> >::iterator mem = it->second.members.begin(); mem != it->second.members.end(); mem++) {
-//            cluster[mem->second] = cluNr;
-//          }
-//          cluNr++;
+//      // Print map in .map format for the Map Generator at www.mapequation.org
+//      // Collapse to two levels
+//      multimap<double,printTreeNode,greater<double> > collapsedmap;
+//      collapseTree(collapsedmap,best_map,size,level);
+//      int Nmod = collapsedmap.size();
+//      vector<int> cluster(Nnode);
+//      int cluNr = 0;
+//      for(multimap<double,printTreeNode,greater<double> >::iterator it = collapsedmap.begin(); it != collapsedmap.end(); it++){
+//        it->second.rank = cluNr;
+//        for (multimap<double,int,greater<double> >::iterator mem = it->second.members.begin(); mem != it->second.members.end(); mem++) {
+//          cluster[mem->second] = cluNr;
 //        }
-//        // Generate modular network
-//        int Nlinks = 0;
-//        multimap<int,multimap<int,double> > unsortedLinks;
-//        for(int i=0;i<Nnode;i++){
-//          int NoutLinks = orig_node[i]->outLinks.size();
-//          Nlinks += NoutLinks;
-//          for(int j=0;j<NoutLinks;j++){
-//            int from = cluster[i];
-//            int to = cluster[orig_node[i]->outLinks[j].first];
-//            double linkFlow = orig_node[i]->outLinks[j].second;
-//            if(to != from){
-//              multimap<int,multimap<int,double> >::iterator fromLink_it = unsortedLinks.find(from);
-//              if(fromLink_it == unsortedLinks.end()){ // new link
-//                multimap<int,double> toLink;
-//                toLink.insert(make_pair(to,linkFlow));
-//                unsortedLinks.insert(make_pair(from,toLink));
+//        cluNr++;
+//      }
+//      // Generate modular network
+//      int Nlinks = 0;
+//      multimap<int,multimap<int,double> > unsortedLinks;
+//      for(int i=0;i<Nnode;i++){
+//        int NoutLinks = orig_node[i]->outLinks.size();
+//        Nlinks += NoutLinks;
+//        for(int j=0;j<NoutLinks;j++){
+//          int from = cluster[i];
+//          int to = cluster[orig_node[i]->outLinks[j].first];
+//          double linkFlow = orig_node[i]->outLinks[j].second;
+//          if(to != from){
+//            multimap<int,multimap<int,double> >::iterator fromLink_it = unsortedLinks.find(from);
+//            if(fromLink_it == unsortedLinks.end()){ // new link
+//              multimap<int,double> toLink;
+//              toLink.insert(make_pair(to,linkFlow));
+//              unsortedLinks.insert(make_pair(from,toLink));
+//            }
+//            else{
+//              multimap<int,double>::iterator toLink_it = fromLink_it->second.find(to);
+//              if(toLink_it == fromLink_it->second.end()){ // new link
+//                fromLink_it->second.insert(make_pair(to,linkFlow));
 //              }
 //              else{
-//                multimap<int,double>::iterator toLink_it = fromLink_it->second.find(to);
-//                if(toLink_it == fromLink_it->second.end()){ // new link
-//                  fromLink_it->second.insert(make_pair(to,linkFlow));
-//                }
-//                else{
-//                  toLink_it->second += linkFlow;
-//                }
+//                toLink_it->second += linkFlow;
 //              }
 //            }
 //          }
 //        }
-//        // Order links by size
-//        vector<double> exit(Nmod,0.0);
-//        multimap<double,pair<int,int>,greater<double> > sortedLinks;
-//        for(multimap<int,multimap<int,double> >::iterator it = unsortedLinks.begin(); it != unsortedLinks.end(); it++){
-//          for(multimap<int,double>::iterator it2 = it->second.begin(); it2 != it->second.end(); it2++){
-//            int from = it->first;
-//            int to = it2->first;
-//            double linkFlow = it2->second;
-//            sortedLinks.insert(make_pair(linkFlow,make_pair(from+1,to+1)));
-//            exit[from] += linkFlow;
-//          }
-//        }
-//        // Print map in .map format for the Map Generator at www.mapequation.org
-//        oss.str("");
-//        oss << networkName << "_level" << level << ".map";
-//        //      oss << networkName << ".map";
-//        outfile.open(oss.str().c_str());
-//        outfile << "# modules: " << Nmod << endl;
-//        outfile << "# modulelinks: " << sortedLinks.size() << endl;
-//        outfile << "# nodes: " << Nnode << endl;
-//        outfile << "# links: " << Nlinks << endl;
-//        outfile << "# codelength: " << codeLength/log(2.0) << endl;
-//        outfile << "*Directed" << endl;
-//        outfile << "*Modules " << Nmod << endl;
-//        for(multimap<double,printTreeNode,greater<double> >::iterator it = collapsedmap.begin(); it != collapsedmap.end(); it++){
-//          outfile << it->second.rank+1 << " \"" << nodeNames[it->second.members.begin()->second] << "\" " << it->second.size << " " << exit[it->second.rank] << endl;
+//      }
+//      // Order links by size
+//      vector<double> exit(Nmod,0.0);
+//      multimap<double,pair<int,int>,greater<double> > sortedLinks;
+//      for(multimap<int,multimap<int,double> >::iterator it = unsortedLinks.begin(); it != unsortedLinks.end(); it++){
+//        for(multimap<int,double>::iterator it2 = it->second.begin(); it2 != it->second.end(); it2++){
+//          int from = it->first;
+//          int to = it2->first;
+//          double linkFlow = it2->second;
+//          sortedLinks.insert(make_pair(linkFlow,make_pair(from+1,to+1)));
+//          exit[from] += linkFlow;
 //        }
-//        outfile << "*Nodes " << Nnode << endl;
-//        
-//        for(multimap<double,printTreeNode,greater<double> >::iterator it = collapsedmap.begin(); it != collapsedmap.end(); it++){
-//          int k=1;
-//          for (multimap<double,int,greater<double> >::iterator mem = it->second.members.begin(); mem != it->second.members.end(); mem++) {
-//            outfile << it->second.rank+1 << ":" << k << " \"" << nodeNames[mem->second] << "\" " << mem->first << endl;
-//            k++;
-//          }
+//      }
+//      // Print map in .map format for the Map Generator at www.mapequation.org
+//      oss.str("");
+//      oss << networkName << "_level" << level << ".map";
+//      //      oss << networkName << ".map";
+//      outfile.open(oss.str().c_str());
+//      outfile << "# modules: " << Nmod << endl;
+//      outfile << "# modulelinks: " << sortedLinks.size() << endl;
+//      outfile << "# nodes: " << Nnode << endl;
+//      outfile << "# links: " << Nlinks << endl;
+//      outfile << "# codelength: " << shortestCodeLength/log(2.0) << endl;
+//      outfile << "*Directed" << endl;
+//      outfile << "*Modules " << Nmod << endl;
+//      for(multimap<double,printTreeNode,greater<double> >::iterator it = collapsedmap.begin(); it != collapsedmap.end(); it++){
+//        outfile << it->second.rank+1 << " \"" << nodeNames[it->second.members.begin()->second] << "\" " << it->second.size << " " << exit[it->second.rank] << endl;
+//      }
+//      outfile << "*Nodes " << Nnode << endl;
+//      
+//      for(multimap<double,printTreeNode,greater<double> >::iterator it = collapsedmap.begin(); it != collapsedmap.end(); it++){
+//        int k=1;
+//        for (multimap<double,int,greater<double> >::iterator mem = it->second.members.begin(); mem != it->second.members.end(); mem++) {
+//          outfile << it->second.rank+1 << ":" << k << " \"" << nodeNames[mem->second] << "\" " << mem->first << endl;
+//          k++;
 //        }
-//        outfile << "*Links " << sortedLinks.size() << endl;
-//        for(multimap<double,pair<int,int>,greater<double> >::iterator it = sortedLinks.begin();it != sortedLinks.end();it++)   
-//          outfile << it->second.first << " " << it->second.second << " " << 1.0*it->first << endl;
-//        outfile.close();
 //      }
-    }
+//      outfile << "*Links " << sortedLinks.size() << endl;
+//      for(multimap<double,pair<int,int>,greater<double> >::iterator it = sortedLinks.begin();it != sortedLinks.end();it++)   
+//        outfile << it->second.first << " " << it->second.second << " " << 1.0*it->first << endl;
+//      outfile.close();
+//    }
     
   }
   
@@ -722,14 +834,16 @@ double repeated_hierarchical_partition(string networkName,vector<double> &size,
   
 }
 
-void partition(MTRand *R, Node ***node, GreedyBase *greedy, bool silent){
+void partition(Random *R, Node ***node, GreedyBase *greedy, bool silent){
   
   int Nnode = greedy->Nnode;
+  perfBegin(PERF_COPY);
   Node **cpy_node = new Node*[Nnode];
   for(int i=0;i<Nnode;i++){
     cpy_node[i] = new Node();
     cpyNode(cpy_node[i],(*node)[i]);
   }
+  perfEnd(PERF_COPY);
   
   int iteration = 0;
   double outer_oldCodeLength;
@@ -739,14 +853,18 @@ void partition(MTRand *R, Node ***node, GreedyBase *greedy, bool silent){
     
     if((iteration > 0) && (iteration % 2 == 0) && (greedy->Nnode > 1)){  // Partition the partition
       
+      PerfRegion region(PERF_SUBMODULE);
+      
       if(!silent)
         cout << "Iteration " << iteration+1 << ", moving ";
       
+      perfBegin(PERF_COPY);
       Node **rpt_node = new Node*[Nnode];
       for(int i=0;i<Nnode;i++){
         rpt_node[i] = new Node();
         cpyNode(rpt_node[i],cpy_node[i]);
       }
+      perfEnd(PERF_COPY);
       vector<int> subMoveTo = vector<int>(Nnode);
       vector<int> moveTo = vector<int>(Nnode);
       int subModIndex = 0;
@@ -757,49 +875,15 @@ void partition(MTRand *R, Node ***node, GreedyBase *greedy, bool silent){
         
         if(sub_Nnode > 1){
           Node **sub_node = new Node*[sub_Nnode]; 
-          set<int> sub_mem;
-          for(int j=0;j<sub_Nnode;j++)
-            sub_mem.insert((*node)[i]->members[j]);
-          set<int>::iterator it_mem = sub_mem.begin();
-          vector<int> sub_renumber = vector<int>(Nnode);
-          vector<int> sub_rev_renumber = vector<int>(sub_Nnode);
-          for(int j=0;j<sub_Nnode;j++){
-            int orig_nr = (*it_mem);
-            int orig_NoutLinks = cpy_node[orig_nr]->outLinks.size();
-            int orig_NinLinks = cpy_node[orig_nr]->inLinks.size();
-            sub_renumber[orig_nr] = j;
-            sub_rev_renumber[j] = orig_nr;
-            sub_node[j] = new Node(j,cpy_node[orig_nr]->teleportWeight);
-            sub_node[j]->selfLink =  cpy_node[orig_nr]->selfLink; // Take care of self-link
-            for(int k=0;k<orig_NoutLinks;k++){
-              int orig_link = cpy_node[orig_nr]->outLinks[k].first;
-              int orig_link_newnr = sub_renumber[orig_link];
-              double orig_weight = cpy_node[orig_nr]->outLinks[k].second;
-              if(orig_link < orig_nr){
-                if(sub_mem.find(orig_link) != sub_mem.end()){
-                  sub_node[j]->outLinks.push_back(make_pair(orig_link_newnr,orig_weight));
-                  sub_node[orig_link_newnr]->inLinks.push_back(make_pair(j,orig_weight));
-                }
-              }
-            }
-            for(int k=0;k<orig_NinLinks;k++){
-              int orig_link = cpy_node[orig_nr]->inLinks[k].first;
-              int orig_link_newnr = sub_renumber[orig_link];
-              double orig_weight = cpy_node[orig_nr]->inLinks[k].second;
-              if(orig_link < orig_nr){
-                if(sub_mem.find(orig_link) != sub_mem.end()){
-                  sub_node[j]->inLinks.push_back(make_pair(orig_link_newnr,orig_weight));
-                  sub_node[orig_link_newnr]->outLinks.push_back(make_pair(j,orig_weight));
-                }
-              }
-            }
-            it_mem++;
-          }
+          vector<int> sub_rev_renumber((*node)[i]->members);
+          sort(sub_rev_renumber.begin(),sub_rev_renumber.end());
+          extractSubNet(cpy_node,Nnode,sub_rev_renumber,sub_node,false);
           
+          Random sub_R = R->split(); // Own stream for each submodule
           GreedyBase* sub_greedy;
-          sub_greedy = new Greedy(R,sub_Nnode,sub_node,true);
+          sub_greedy = new Greedy(&sub_R,sub_Nnode,sub_node,true);
           sub_greedy->initiate();
-          partition(R,&sub_node,sub_greedy,true);
+          partition(&sub_R,&sub_node,sub_greedy,true);
           for(int j=0;j<sub_greedy->Nnode;j++){
             int Nmembers = sub_node[j]->members.size();
             for(int k=0;k<Nmembers;k++){
@@ -847,11 +931,13 @@ void partition(MTRand *R, Node ***node, GreedyBase *greedy, bool silent){
       if(!silent)
         cout << "Iteration " << iteration+1 << ", moving " << Nnode << " nodes, looping ";
       
+      perfBegin(PERF_COPY);
       Node **rpt_node = new Node*[Nnode];
       for(int i=0;i<Nnode;i++){
         rpt_node[i] = new Node();
         cpyNode(rpt_node[i],cpy_node[i]);
       }
+      perfEnd(PERF_COPY);
       
       vector<int> moveTo = vector<int>(Nnode);
       for(int i=0;i<greedy->Nnode;i++){
@@ -892,7 +978,7 @@ void partition(MTRand *R, Node ***node, GreedyBase *greedy, bool silent){
         greedy->move(moved);
         Nloops++;
         count++;
-        if(fabs(greedy->codeLength - inner_oldCodeLength) < 1.0e-10)
+        if(fabs(greedy->codeLength - inner_oldCodeLength) < 1.0e-10 || budgetSpent())
           moved = false;
         
         if(count == 10){	  
@@ -906,13 +992,13 @@ void partition(MTRand *R, Node ***node, GreedyBase *greedy, bool silent){
       if(!silent)
         cout << Nloops << " ";
       
-    } while(oldCodeLength - greedy->codeLength >  1.0e-10);
+    } while(oldCodeLength - greedy->codeLength >  1.0e-10 && !budgetSpent());
     
     iteration++;
     if(!silent)
       cout << "times between mergings to code length " <<  greedy->codeLength/log(2.0) << " in " << greedy->Nmod << " modules." << endl;
     
-  } while(outer_oldCodeLength - greedy->codeLength > 1.0e-10 && iteration < 20);
+  } while(outer_oldCodeLength - greedy->codeLength > 1.0e-10 && iteration < 20 && !budgetSpent());
   
   for(int i=0;i<Nnode;i++)
     delete cpy_node[i];
@@ -920,30 +1006,39 @@ void partition(MTRand *R, Node ***node, GreedyBase *greedy, bool silent){
   
 }
 
-void repeated_partition(MTRand *R, Node ***node, GreedyBase *greedy, bool silent,int Ntrials){
+void repeated_partition(Random *R, Node ***node, GreedyBase *greedy, bool silent,int Ntrials){
   
   double shortestCodeLength = 1000.0;
   int Nnode = greedy->Nnode;
   vector<int> cluster = vector<int>(Nnode);
   
-  for(int trial = 0; trial<Ntrials;trial++){
+  int Nstale = 0; // Attempts since the last improvement
+  for(int trial = 0; budgetNextTrial(trial,Ntrials,Nstale,silent); trial++){
     
     if(!silent)
-      cout << "Attempt " << trial+1 << "/" << Ntrials << endl;
+      cout << "Attempt " << trial+1 << (Ntrials > 0 ? "/" + to_string(Ntrials) : string("")) << endl;
     
+    perfBegin(PERF_COPY);
     Node **cpy_node = new Node*[Nnode];
     for(int i=0;i<Nnode;i++){
       cpy_node[i] = new Node();
       cpyNode(cpy_node[i],(*node)[i]);
     }
+    perfEnd(PERF_COPY);
     
     greedy->Nnode = Nnode;
     greedy->Nmod = Nnode;
     greedy->node = cpy_node;
     greedy->calibrate();
     
-    partition(R,&cpy_node,greedy,silent);
+    Random trial_R = R->split(trial); // Own stream for each trial
+    greedy->setRandom(&trial_R);
+    partition(&trial_R,&cpy_node,greedy,silent);
     
+    if(greedy->codeLength < shortestCodeLength - 1.0e-10)
+      Nstale = 0;
+    else
+      Nstale++;
     if(greedy->codeLength < shortestCodeLength){
       
       shortestCodeLength = greedy->codeLength;
@@ -963,6 +1058,8 @@ void repeated_partition(MTRand *R, Node ***node, GreedyBase *greedy, bool silent
     
   }
   
+  greedy->setRandom(R);
+  
   // Commit best partition
   greedy->Nnode = Nnode;
   greedy->Nmod = Nnode;
@@ -8,10 +8,14 @@
 #include <sstream>
 #include <fstream>
 #include <iomanip>
-#include "MersenneTwister.h"
+#include "Random.h"
 #include "GreedyBase.h" 
 #include "Greedy.h" 
 #include "Node.h" 
+#include "PerfCounters.h"
+#include "AllocTracker.h"
+#include "Budget.h"
+#include "SubNet.h"
 #define PI 3.14159265
 using namespace std;
 
@@ -43,9 +47,17 @@ public:
   double codeLength;
   set<int> members;
   //  vector<int> cluster; // Two-level partition
-  vector<int> rev_renumber; // Vectors to reorganize node numbers
-  map<int,int> renumber;
+  vector<int> rev_renumber; // Original number of the nodes of the subnetwork, in increasing order
   multimap<double,treeNode,greater<double> > nextLevel;
+  
+  // Exchange two trees without copying members or subtrees
+  void swap(treeNode &t){
+    std::swap(level,t.level);
+    std::swap(codeLength,t.codeLength);
+    members.swap(t.members);
+    rev_renumber.swap(t.rev_renumber);
+    nextLevel.swap(t.nextLevel);
+  }
 };
 
 class printTreeNode{
@@ -77,71 +89,71 @@ inline std::string to_string (const T& t){
   return ss.str();
 }
 
+// Index of the first --option argument, or argc if there are none
+int firstOption(int argc,char *argv[]){
+  for(int i=1;i<argc;i++)
+    if(strncmp(argv[i],"--",2) == 0)
+      return i;
+  return argc;
+}
+
+// Read a partition in Pajek's .clu format, as written by the programs, and
+// number every module by its first node. Moving each node to the module of
+// its first member never fills a module that has been emptied, as determMove
+// expects.
+void loadPartition(string file,int Nnode,vector<int> &cluster){
+  
+  cout << "Reading initial partition " << file << "..." << flush;
+  ifstream clu(file.c_str());
+  if(!clu){
+    cout << "cannot open the file...exiting" << endl;
+    exit(-1);
+  }
+  string line;
+  string buf;
+  istringstream ss;
+  int Nclu = -1;
+  while(Nclu < 0 && getline(clu,line)){
+    ss.clear();
+    ss.str(line);
+    buf = "";
+    ss >> buf;
+    if(buf == "*Vertices" || buf == "*vertices" || buf == "*VERTICES")
+      ss >> Nclu;
+  }
+  if(Nclu != Nnode){
+    cout << "the partition has " << Nclu << " nodes, the network " << Nnode << "...exiting" << endl;
+    exit(-1);
+  }
+  
+  cluster = vector<int>(Nnode);
+  map<int,int> first;
+  for(int i=0;i<Nnode;i++){
+    int mod;
+    if(!(clu >> mod)){
+      cout << "the partition ends after " << i << " nodes...exiting" << endl;
+      exit(-1);
+    }
+    map<int,int>::iterator it = first.find(mod);
+    if(it == first.end())
+      it = first.insert(make_pair(mod,i)).first;
+    cluster[i] = it->second;
+  }
+  cout << "done! (" << first.size() << " modules)" << endl;
+  
+}
+
 void genSubNet(Node **orig_node,int Nnode, Node **sub_node,int sub_Nnode, treeNode &map){
     
-  vector<int>(sub_Nnode).swap(map.rev_renumber);
-  //  vector<int>(Nnode,-1).swap(map.renumber);
-  std::map<int,int>().swap(map.renumber); 
+  PerfRegion region(PERF_HIERARCHY);
   
-  double outFlow = 0.0;
-  double size = 0.0;
-
   // Construct sub network
-  set<int>::iterator it_mem = map.members.begin();
-  for(int i=0;i<sub_Nnode;i++){
-    int orig_nr = (*it_mem);
-    map.renumber[orig_nr] = i;
-    map.rev_renumber[i] = orig_nr;
-    it_mem++;
-  }
-  it_mem = map.members.begin();
-  for(int i=0;i<sub_Nnode;i++){
-    int orig_nr = (*it_mem);
-    int orig_NoutLinks = orig_node[orig_nr]->outLinks.size();
-    int orig_NinLinks = orig_node[orig_nr]->inLinks.size();
-    sub_node[i] = new Node(i,orig_node[orig_nr]->teleportWeight);
-    sub_node[i]->size = orig_node[orig_nr]->size;
-    sub_node[i]->selfLink = orig_node[orig_nr]->selfLink; // Take care of self-link
+  vector<int>(map.members.begin(),map.members.end()).swap(map.rev_renumber);
+  double outFlow = extractSubNet(orig_node,Nnode,map.rev_renumber,sub_node,true);
+  
+  double size = 0.0;
+  for(int i=0;i<sub_Nnode;i++)
     size += sub_node[i]->size;
-    
-    for(int j=0;j<orig_NoutLinks;j++){
-      int orig_link = orig_node[orig_nr]->outLinks[j].first;
-      //int orig_link_newnr = map.renumber[orig_link];
-      int orig_link_newnr = -1;
-      std::map<int,int>::iterator it = map.renumber.find(orig_link);
-      if(it != map.renumber.end())
-        orig_link_newnr = it->second;
-      double orig_weight = orig_node[orig_nr]->outLinks[j].second;
-      if(orig_link_newnr < 0){
-        sub_node[i]->outFlow += orig_weight;
-        outFlow += orig_weight;
-      }
-      else if(orig_link < orig_nr){
-        if(map.members.find(orig_link) != map.members.end()){
-          sub_node[i]->outLinks.push_back(make_pair(orig_link_newnr,orig_weight));
-          sub_node[orig_link_newnr]->inLinks.push_back(make_pair(i,orig_weight));
-        }
-      }
-    }
-    
-    for(int j=0;j<orig_NinLinks;j++){
-      int orig_link = orig_node[orig_nr]->inLinks[j].first;
-      //int orig_link_newnr = map.renumber[orig_link];
-      int orig_link_newnr = -1;
-      std::map<int,int>::iterator it = map.renumber.find(orig_link);
-      if(it != map.renumber.end())
-        orig_link_newnr = it->second;
-      double orig_weight = orig_node[orig_nr]->inLinks[j].second;
-      if(orig_link < orig_nr){
-        if(map.members.find(orig_link) != map.members.end()){
-          sub_node[i]->inLinks.push_back(make_pair(orig_link_newnr,orig_weight));
-          sub_node[orig_link_newnr]->outLinks.push_back(make_pair(i,orig_weight));
-        }
-      }
-    }
-    
-    it_mem++;
-  }
       
   double totFlow = size + outFlow;
   
@@ -263,6 +275,7 @@ void addNodesToMap(treeNode &map,vector<double> &size){
   else{
     for(set<int>::iterator mem = map.members.begin(); mem != map.members.end(); mem++){
       treeNode tmp;
+      tmp.level = map.level + 1;
       tmp.members.insert((*mem));
       map.nextLevel.insert(make_pair(size[(*mem)],tmp));
     }
@@ -1,4 +1,7 @@
 #include "Greedy.h"
+#include "PerfCounters.h"
+
+LinkOrder GreedyBase::linkOrder = LINKS_SHUFFLE;
 
 Greedy::~Greedy(){
   
@@ -6,7 +9,7 @@ Greedy::~Greedy(){
 	
 }
 
-Greedy::Greedy(MTRand *RR,int nnode,double deg,Node **ah){
+Greedy::Greedy(Random *RR,int nnode,double deg,Node **ah){
 	
   R = RR;
   Nnode = nnode;  
@@ -19,16 +22,13 @@ Greedy::Greedy(MTRand *RR,int nnode,double deg,Node **ah){
 
 void Greedy::move(bool &moved){
 	
+  PerfRegion region(PERF_MOVE);
+  
   // Generate random enumeration of nodes
   vector<int> randomOrder(Nnode);
   for(int i=0;i<Nnode;i++)
     randomOrder[i] = i;
-  for(int i=0;i<Nnode-1;i++){
-    int randPos = i + R->randInt(Nnode-i-1);
-    int tmp = randomOrder[i];
-    randomOrder[i] = randomOrder[randPos];
-    randomOrder[randPos] = tmp;
-  }
+  R->shuffle(&randomOrder[0],Nnode);
   
   unsigned int offset = 1;    
   vector<unsigned int> redirect(Nnode,0);
@@ -78,23 +78,23 @@ void Greedy::move(bool &moved){
       }
     }
 		
-    // Randomize link order
-    for(int j=0;j<NmodLinks-1;j++){
-      int randPos = j + R->randInt(NmodLinks-j-1);
-      int tmp_M = wNtoM[j].first;
-      double tmp_w = wNtoM[j].second;
-      wNtoM[j].first = wNtoM[randPos].first;
-      wNtoM[j].second = wNtoM[randPos].second;
-      wNtoM[randPos].first = tmp_M;
-      wNtoM[randPos].second = tmp_w;
-    }
+    // Randomize link order for optimized search
+    int start = 0;
+    int Nties = 1;
+    if(linkOrder == LINKS_SHUFFLE)
+      R->shuffle(&wNtoM[0],NmodLinks);
+    else if(linkOrder == LINKS_ROTATE && NmodLinks > 1)
+      start = R->randBelow(NmodLinks);
 		
     int bestM = fromM;
     int best_weight = 0.0;
     double best_delta = 0.0;
     
     // Find the move that minimizes the description length
-    for (int j=0; j<NmodLinks; j++) {
+    for (int l=0; l<NmodLinks; l++) {
+      int j = l + start;
+      if(j >= NmodLinks)
+        j -= NmodLinks;
       
       int toM = wNtoM[j].first;
       double wtoM = wNtoM[j].second;
@@ -112,7 +112,15 @@ void Greedy::move(bool &moved){
 				
 				double deltaL = delta_exit - 2.0*delta_exit_log_exit + delta_degree_log_degree;
 				
-				if(deltaL < best_delta){
+				bool better = deltaL < best_delta;
+				if(linkOrder == LINKS_TIEBREAK){
+					// Pick uniformly among equally good moves
+					if(better)
+						Nties = 1;
+					else if(deltaL == best_delta && bestM != fromM)
+						better = (R->randBelow(++Nties) == 0);
+				}
+				if(better){
 					bestM = toM;
 					best_weight = wtoM;
 					best_delta = deltaL;  
@@ -309,6 +317,8 @@ void Greedy::prepare(bool sort){
 
 void Greedy::level(Node ***node_tmp, bool sort){
   
+  PerfRegion region(PERF_LEVEL);
+  
   prepare(sort);
   
   (*node_tmp) = new Node*[Nmod];
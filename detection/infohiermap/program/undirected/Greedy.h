@@ -1,9 +1,10 @@
 #ifndef GREEDY_H
 #define GREEDY_H
-#include "MersenneTwister.h"
+#include "Random.h"
 #include "GreedyBase.h"
 #include "Node.h"
 #include <cmath>
+#include <climits>
 #include <iostream>
 #include <vector>
 #include <set>
@@ -13,7 +14,7 @@ using namespace std;
 
 class Greedy : public GreedyBase{
  public:
-  Greedy(MTRand *RR,int nnode,double deg,Node **node);
+  Greedy(Random *RR,int nnode,double deg,Node **node);
   virtual ~Greedy();
   virtual void initiate(void);
   virtual void calibrate(void);
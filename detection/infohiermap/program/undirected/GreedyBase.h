@@ -1,11 +1,13 @@
 #ifndef GREEDYBASE_H
 #define GREEDYBASE_H
-#include "MersenneTwister.h"
+#include "Random.h"
 #include <cstdio>
 #include <vector>
 using namespace std;
 // forward declaration
 class Node;
+// Order in which move() tries the modules linked to a node
+enum LinkOrder {LINKS_SHUFFLE,LINKS_ROTATE,LINKS_TIEBREAK};
 class GreedyBase{
  public:
   GreedyBase(){};
@@ -17,6 +19,8 @@ class GreedyBase{
   virtual void level(Node ***, bool sort){};
   virtual void move(bool &moved){};
   virtual void determMove(vector<int> &moveTo){};
+  void setRandom(Random *RR){ R = RR; }; // Draw from another stream, e.g. one per trial
+  static LinkOrder linkOrder;
   int Nmod;
   int Nnode;
  
@@ -40,7 +44,7 @@ class GreedyBase{
  
  protected:
 
-  MTRand *R;
+  Random *R;
  
 };
 
@@ -0,0 +1,50 @@
+#include "SubNet.h"
+
+static vector<int> subLocal;          // Local number of an original node
+static vector<unsigned int> subEpoch; // Extraction that set subLocal
+static unsigned int epoch = 0;
+
+double extractSubNet(Node **orig_node,int Nnode,vector<int> &members,Node **sub_node,bool exits){
+  
+  if(static_cast<int>(subLocal.size()) < Nnode){
+    subLocal.resize(Nnode);
+    subEpoch.resize(Nnode,0);
+  }
+  epoch++;
+  if(epoch == 0){ // Wrapped around, forget all tags
+    fill(subEpoch.begin(),subEpoch.end(),0);
+    epoch = 1;
+  }
+  
+  int sub_Nnode = members.size();
+  for(int j=0;j<sub_Nnode;j++){
+    subLocal[members[j]] = j;
+    subEpoch[members[j]] = epoch;
+  }
+  
+  double internal = 0.0;
+  for(int j=0;j<sub_Nnode;j++){
+    int orig_nr = members[j];
+    int orig_Nlinks = orig_node[orig_nr]->links.size();
+    sub_node[j] = new Node(j);
+    for(int k=0;k<orig_Nlinks;k++){
+      int orig_link = orig_node[orig_nr]->links[k].first;
+      double orig_weight = orig_node[orig_nr]->links[k].second;
+      bool inside = subEpoch[orig_link] == epoch;
+      if(exits){
+        sub_node[j]->degree += orig_weight;
+        if(!inside)
+          sub_node[j]->outDegree += orig_weight;
+      }
+      if(inside && orig_link < orig_nr){ // Should be <= if self-links are included
+        int orig_link_newnr = subLocal[orig_link];
+        sub_node[j]->links.push_back(make_pair(orig_link_newnr,orig_weight));
+        sub_node[orig_link_newnr]->links.push_back(make_pair(j,orig_weight));
+        internal += 2.0*orig_weight;
+      }
+    }
+  }
+  
+  return internal;
+  
+}
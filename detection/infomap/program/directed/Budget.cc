@@ -0,0 +1,109 @@
+#include "Budget.h"
+#include <iostream>
+#include <cstring>
+#include <sys/time.h>
+using namespace std;
+
+static double budgetTime = 0.0; // Seconds, 0 for no limit
+static int budgetPatience = 0;  // Attempts, 0 for no limit
+static double budgetStart;
+static bool budgetOver = false;
+static bool budgetAbandon = false;
+// Bit patterns of the best code length and of the smallest ratio between the
+// final code length and the code length after the first coarsening
+static volatile unsigned long long budgetBest = 0x7FF0000000000000ULL;  // +inf
+static volatile unsigned long long budgetRatio = 0x7FF0000000000000ULL; // +inf
+
+static double wallTime(void){
+  struct timeval tv;
+  gettimeofday(&tv,NULL);
+  return tv.tv_sec + 1.0e-6*tv.tv_usec;
+}
+
+void budgetSetTime(double seconds){
+  budgetTime = seconds;
+  budgetStart = wallTime();
+}
+
+void budgetSetPatience(int attempts){
+  budgetPatience = attempts;
+}
+
+bool budgetLimited(void){
+  return budgetTime > 0.0 || budgetPatience > 0;
+}
+
+bool budgetSpent(void){
+
+  if(budgetTime <= 0.0)
+    return false;
+  if(!budgetOver)
+    budgetOver = (wallTime() - budgetStart >= budgetTime);
+  return budgetOver;
+
+}
+
+bool budgetNextTrial(int trial,int Ntrials,int Nstale,bool silent){
+
+  if(Ntrials > 0 && trial >= Ntrials)
+    return false;
+  if(trial == 0)
+    return true;
+  if(budgetSpent()){
+    if(!silent)
+      cout << "Time budget of " << budgetTime << " s spent after " << trial << " attempt(s)." << endl;
+    return false;
+  }
+  if(budgetPatience > 0 && Nstale >= budgetPatience){
+    if(!silent)
+      cout << "No improvement in the last " << Nstale << " attempts, stopping after " << trial << " attempt(s)." << endl;
+    return false;
+  }
+  return true;
+
+}
+
+static double fromBits(unsigned long long bits){
+  double value;
+  memcpy(&value,&bits,sizeof(value));
+  return value;
+}
+
+// Lower *bits to value, retrying when another thread got in between
+static void atomicMin(volatile unsigned long long *bits,double value){
+
+  unsigned long long old = *bits;
+  while(value < fromBits(old)){
+    unsigned long long next;
+    memcpy(&next,&value,sizeof(next));
+    unsigned long long seen = __sync_val_compare_and_swap(bits,old,next);
+    if(seen == old)
+      return;
+    old = seen;
+  }
+
+}
+
+void budgetSetAbandon(void){
+  budgetAbandon = true;
+}
+
+void budgetOffer(double codeLength){
+  if(budgetAbandon)
+    atomicMin(&budgetBest,codeLength);
+}
+
+bool budgetHopeless(double firstCodeLength){
+
+  // No finished attempt yet while the ratio is still +inf
+  double ratio = fromBits(budgetRatio);
+  if(!budgetAbandon || ratio > 1.0)
+    return false;
+  return firstCodeLength*ratio > fromBits(budgetBest) + 1.0e-10;
+
+}
+
+void budgetRecordTrial(double firstCodeLength,double codeLength){
+  if(budgetAbandon && firstCodeLength > 0.0)
+    atomicMin(&budgetRatio,codeLength/firstCodeLength);
+}
@@ -0,0 +1,25 @@
+#ifndef BUDGET_H
+#define BUDGET_H
+
+// Stopping rules for the repeated partition attempts: a wall-clock budget for
+// the whole run and a patience in attempts without improvement. When the time
+// budget is spent, the running attempt stops at its next sweep and the best
+// partition found so far is returned.
+void budgetSetTime(double seconds);
+void budgetSetPatience(int attempts);
+bool budgetLimited(void);
+bool budgetSpent(void);
+// Whether to start attempt trial (from 0) of at most Ntrials (0 for no limit),
+// Nstale attempts after the last improvement
+bool budgetNextTrial(int trial,int Ntrials,int Nstale,bool silent);
+
+// Early abandonment of attempts. After its first coarsening, an attempt is
+// given up when even the largest relative improvement seen in any finished
+// attempt after that point would not bring it below the best code length.
+// Both values are shared lock-free, so concurrent attempts can use them.
+void budgetSetAbandon(void);
+void budgetOffer(double codeLength);
+bool budgetHopeless(double firstCodeLength);
+void budgetRecordTrial(double firstCodeLength,double codeLength);
+
+#endif
@@ -0,0 +1,245 @@
+#include "LinkStore.h"
+#include <iostream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <queue>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define LINKSTORE_MAGIC 0x31525343LL // "CSR1"
+#define LINKSTORE_HEADER 4           // long longs before the links
+
+static bool recordLess(const LinkStore::Record &a,const LinkStore::Record &b){
+  return a.from < b.from || (a.from == b.from && a.to < b.to);
+}
+
+// Next record of a run in the merge, ties go to the earlier run so that
+// weights are added in the order they were read
+class RunHead{
+ public:
+  LinkStore::Record rec;
+  int run;
+  bool operator>(const RunHead &b) const {
+    if(rec.from != b.rec.from)
+      return rec.from > b.rec.from;
+    if(rec.to != b.rec.to)
+      return rec.to > b.rec.to;
+    return run > b.run;
+  }
+};
+
+// Buffered reading of one run file
+class RunReader{
+ public:
+  FILE *in;
+  vector<LinkStore::Record> buf;
+  size_t pos;
+  size_t count;
+  bool next(LinkStore::Record &rec){
+    if(pos == count){
+      count = fread(&buf[0],sizeof(LinkStore::Record),buf.size(),in);
+      pos = 0;
+      if(count == 0)
+        return false;
+    }
+    rec = buf[pos++];
+    return true;
+  }
+};
+
+LinkStore::LinkStore(string p,double memLimit){
+
+  prefix = p;
+  maxRecords = static_cast<size_t>(memLimit/sizeof(Record));
+  if(maxRecords < 1024)
+    maxRecords = 1024;
+  Nlinks = 0;
+  NdoubleLinks = 0;
+  Nruns = 0;
+  fd = -1;
+  mapSize = 0;
+  mapped = NULL;
+  links = NULL;
+  offsets = NULL;
+
+}
+
+LinkStore::~LinkStore(){
+
+  if(mapped != NULL)
+    munmap(mapped,mapSize);
+  if(fd >= 0){
+    close(fd);
+    unlink(csrName.c_str());
+  }
+
+}
+
+string LinkStore::runName(int run){
+  ostringstream oss;
+  oss << prefix << ".run" << run;
+  return oss.str();
+}
+
+void LinkStore::add(int from,int to,double weight){
+
+  if(buffer.empty())
+    buffer.reserve(maxRecords);
+  Record rec;
+  rec.from = from;
+  rec.to = to;
+  rec.weight = weight;
+  buffer.push_back(rec);
+  if(buffer.size() >= maxRecords)
+    spill();
+
+}
+
+// Sort the buffer, add up repeated links and write it as the next run
+void LinkStore::spill(void){
+
+  stable_sort(buffer.begin(),buffer.end(),recordLess);
+  size_t Nunique = 0;
+  for(size_t i=0;i<buffer.size();i++){
+    if(Nunique > 0 && buffer[Nunique-1].from == buffer[i].from && buffer[Nunique-1].to == buffer[i].to){
+      buffer[Nunique-1].weight += buffer[i].weight;
+      NdoubleLinks++;
+    }
+    else
+      buffer[Nunique++] = buffer[i];
+  }
+
+  string name = runName(Nruns);
+  FILE *out = fopen(name.c_str(),"wb");
+  if(out == NULL || fwrite(&buffer[0],sizeof(Record),Nunique,out) != Nunique){
+    cout << "Cannot write link run " << name << "...exiting" << endl;
+    exit(-1);
+  }
+  fclose(out);
+  Nruns++;
+  buffer.clear();
+
+}
+
+void LinkStore::finish(int Nnode,map<int,int> *renumber){
+
+  if(!buffer.empty())
+    spill();
+  vector<Record>().swap(buffer);
+
+  // The read buffers of all runs share the memory limit
+  size_t bufRecords = maxRecords/(Nruns + 1);
+  if(bufRecords < 256)
+    bufRecords = 256;
+  vector<RunReader> runs(Nruns);
+  priority_queue<RunHead,vector<RunHead>,greater<RunHead> > heads;
+  for(int r=0;r<Nruns;r++){
+    string name = runName(r);
+    runs[r].in = fopen(name.c_str(),"rb");
+    if(runs[r].in == NULL){
+      cout << "Cannot read link run " << name << "...exiting" << endl;
+      exit(-1);
+    }
+    runs[r].buf = vector<Record>(bufRecords);
+    runs[r].pos = runs[r].count = 0;
+    RunHead head;
+    head.run = r;
+    if(runs[r].next(head.rec))
+      heads.push(head);
+  }
+
+  csrName = prefix + ".csr";
+  FILE *out = fopen(csrName.c_str(),"wb");
+  if(out == NULL){
+    cout << "Cannot write link file " << csrName << "...exiting" << endl;
+    exit(-1);
+  }
+  long long header[LINKSTORE_HEADER] = {LINKSTORE_MAGIC,Nnode,0,0};
+  fwrite(header,sizeof(long long),LINKSTORE_HEADER,out);
+
+  // Links of node i are counted in offs[i+1] and summed up at the end
+  vector<long long> offs(Nnode+1,0);
+  Record last;
+  bool pending = false;
+  while(!heads.empty()){
+    RunHead head = heads.top();
+    heads.pop();
+    Record rec = head.rec;
+    if(runs[head.run].next(head.rec))
+      heads.push(head);
+
+    if(pending && last.from == rec.from && last.to == rec.to){
+      last.weight += rec.weight;
+      NdoubleLinks++;
+      continue;
+    }
+    if(pending)
+      writeLink(out,last,renumber,offs);
+    last = rec;
+    pending = true;
+  }
+  if(pending)
+    writeLink(out,last,renumber,offs);
+
+  for(int r=0;r<Nruns;r++){
+    fclose(runs[r].in);
+    unlink(runName(r).c_str());
+  }
+
+  for(int i=0;i<Nnode;i++)
+    offs[i+1] += offs[i];
+  Nlinks = static_cast<int>(offs[Nnode]);
+  header[2] = offs[Nnode];
+  header[3] = static_cast<long long>(sizeof(long long))*LINKSTORE_HEADER + static_cast<long long>(sizeof(CsrLink))*offs[Nnode];
+  if(fwrite(&offs[0],sizeof(long long),Nnode+1,out) != static_cast<size_t>(Nnode+1) || fseek(out,0,SEEK_SET) != 0 || fwrite(header,sizeof(long long),LINKSTORE_HEADER,out) != LINKSTORE_HEADER){
+    cout << "Cannot write link file " << csrName << "...exiting" << endl;
+    exit(-1);
+  }
+  fclose(out);
+  vector<long long>().swap(offs);
+
+  fd = open(csrName.c_str(),O_RDONLY);
+  struct stat st;
+  if(fd < 0 || fstat(fd,&st) != 0){
+    cout << "Cannot read link file " << csrName << "...exiting" << endl;
+    exit(-1);
+  }
+  mapSize = st.st_size;
+  mapped = mmap(NULL,mapSize,PROT_READ,MAP_SHARED,fd,0);
+  if(mapped == MAP_FAILED){
+    mapped = NULL;
+    cout << "Cannot map link file " << csrName << "...exiting" << endl;
+    exit(-1);
+  }
+  links = reinterpret_cast<CsrLink *>(static_cast<long long *>(mapped) + LINKSTORE_HEADER);
+  offsets = static_cast<long long *>(mapped) + header[3]/sizeof(long long);
+
+}
+
+// Append one merged link, with the node ids renumbered if asked
+void LinkStore::writeLink(FILE *out,Record &rec,map<int,int> *renumber,vector<long long> &offs){
+
+  CsrLink link;
+  int from = rec.from;
+  link.to = rec.to;
+  link.weight = rec.weight;
+  if(renumber != NULL){
+    from = renumber->find(from)->second;
+    link.to = renumber->find(link.to)->second;
+  }
+  int Nnode = offs.size() - 1;
+  if(from < 0 || from >= Nnode || link.to < 0 || link.to >= Nnode){
+    cout << "Link " << rec.from+1 << " " << rec.to+1 << " is not between nodes 1 and " << Nnode << "...exiting" << endl;
+    exit(-1);
+  }
+  if(fwrite(&link,sizeof(CsrLink),1,out) != 1){
+    cout << "Cannot write link file " << csrName << "...exiting" << endl;
+    exit(-1);
+  }
+  offs[from+1]++;
+
+}
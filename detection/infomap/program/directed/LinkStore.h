@@ -0,0 +1,68 @@
+#ifndef LINKSTORE_H
+#define LINKSTORE_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <map>
+using namespace std;
+
+// Links of a network built on disk instead of in a map, for networks whose
+// links do not fit in memory. Links are collected in a buffer of at most the
+// memory limit, which is sorted, aggregated and written to a run file each
+// time it is full. finish merges the runs, adding the weights of links that
+// occur more than once, into one file in compressed sparse row format:
+//   header   magic, Nnode, Nlinks, position of the offsets
+//   links    (to, weight) of all links ordered by (from, to)
+//   offsets  Nnode+1 positions in links, the links of node i are
+//            offsets[i] to offsets[i+1]-1
+// The file is then memory-mapped and read in place. All files are named
+// after prefix and removed when the store is deleted.
+class LinkStore{
+ public:
+  LinkStore(string prefix,double memLimit);
+  ~LinkStore();
+  void add(int from,int to,double weight);
+  // Merge the runs for nodes 0..Nnode-1. If renumber is given, the links
+  // were added with the ids in its keys, which must be in the same order as
+  // their new numbers.
+  void finish(int Nnode,map<int,int> *renumber);
+
+  int Nlinks;
+  int NdoubleLinks;
+  int Nruns;
+
+  // Links of the memory-mapped file
+  long long begin(int from){ return offsets[from]; }
+  long long end(int from){ return offsets[from+1]; }
+  int to(long long k){ return links[k].to; }
+  double weight(long long k){ return links[k].weight; }
+
+  struct Record{
+    int from;
+    int to;
+    double weight;
+  };
+  struct CsrLink{
+    int to;
+    double weight;
+  };
+
+ private:
+  void spill(void);
+  void writeLink(FILE *out,Record &rec,map<int,int> *renumber,vector<long long> &offs);
+  string runName(int run);
+
+  string prefix;
+  size_t maxRecords;
+  vector<Record> buffer;
+
+  string csrName;
+  int fd;
+  size_t mapSize;
+  void *mapped;
+  CsrLink *links;
+  long long *offsets;
+};
+
+#endif
@@ -0,0 +1,182 @@
+#include "PerfCounters.h"
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#define PERF_NEVENTS 4
+#define PERF_MAXDEPTH 64
+
+static const char *perfPhaseNames[PERF_NPHASES+1] = {"move","level","eigenvector","load","copy","submodule","hierarchy","significance","other"};
+static const char *perfEventNames[PERF_NEVENTS] = {"cycles","instructions","LLC misses","branch misses"};
+
+static bool perfOn = false;
+static bool perfPhases = false;
+static int perfLeader = -1;
+static int perfFd[PERF_NEVENTS];
+static int perfSlot[PERF_NEVENTS]; // Position in the group read, -1 if the event could not be opened
+static __thread int perfDepth[PERF_NPHASES];
+static __thread int perfStack[PERF_MAXDEPTH];
+static __thread int perfStackSize;
+static long perfCalls[PERF_NPHASES];
+static unsigned long long perfStart[PERF_NPHASES][PERF_NEVENTS+2];
+static unsigned long long perfTotal[PERF_NPHASES][PERF_NEVENTS+2];
+
+#ifdef __linux__
+static int perfOpen(unsigned long long config,int group){
+
+  struct perf_event_attr attr;
+  memset(&attr,0,sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = config;
+  attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  attr.disabled = (group == -1) ? 1 : 0;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return syscall(__NR_perf_event_open,&attr,0,-1,group,0);
+
+}
+#endif
+
+// Reads the event counts followed by time enabled and time running
+static bool perfRead(unsigned long long *values){
+
+#ifdef __linux__
+  unsigned long long buf[3+PERF_NEVENTS];
+  if(read(perfLeader,buf,sizeof(buf)) < (ssize_t)(3*sizeof(unsigned long long)))
+    return false;
+  for(int e=0;e<PERF_NEVENTS;e++)
+    values[e] = (perfSlot[e] >= 0) ? buf[3+perfSlot[e]] : 0;
+  values[PERF_NEVENTS] = buf[1];
+  values[PERF_NEVENTS+1] = buf[2];
+  return true;
+#else
+  return false;
+#endif
+
+}
+
+bool perfEnable(void){
+
+#ifdef __linux__
+  unsigned long long config[PERF_NEVENTS] = {PERF_COUNT_HW_CPU_CYCLES,PERF_COUNT_HW_INSTRUCTIONS,PERF_COUNT_HW_CACHE_MISSES,PERF_COUNT_HW_BRANCH_MISSES};
+  int Nopen = 0;
+  for(int e=0;e<PERF_NEVENTS;e++){
+    perfFd[e] = perfOpen(config[e],perfLeader);
+    if(perfFd[e] < 0){
+      perfSlot[e] = -1;
+      if(e == 0){
+        cout << "Hardware performance counters unavailable (" << strerror(errno) << "), continuing without them." << endl;
+        return false;
+      }
+    }
+    else{
+      perfSlot[e] = Nopen++;
+      if(e == 0)
+        perfLeader = perfFd[e];
+    }
+  }
+
+  ioctl(perfLeader,PERF_EVENT_IOC_RESET,PERF_IOC_FLAG_GROUP);
+  ioctl(perfLeader,PERF_EVENT_IOC_ENABLE,PERF_IOC_FLAG_GROUP);
+  unsigned long long values[PERF_NEVENTS+2];
+  if(!perfRead(values)){
+    for(int e=0;e<PERF_NEVENTS;e++)
+      if(perfFd[e] >= 0)
+        close(perfFd[e]);
+    cout << "Hardware performance counters unavailable (cannot read counters), continuing without them." << endl;
+    return false;
+  }
+  perfOn = true;
+  perfPhases = true;
+  return true;
+#else
+  cout << "Hardware performance counters unavailable on this platform, continuing without them." << endl;
+  return false;
+#endif
+
+}
+
+bool perfEnabled(void){
+  return perfOn;
+}
+
+void perfTrackPhases(void){
+  perfPhases = true;
+}
+
+int perfPhase(void){
+  if(perfStackSize == 0)
+    return PERF_NPHASES;
+  return perfStack[min(perfStackSize,PERF_MAXDEPTH)-1];
+}
+
+bool perfActive(int phase){
+  return perfDepth[phase] > 0;
+}
+
+const char *perfPhaseName(int phase){
+  return perfPhaseNames[phase];
+}
+
+void perfBegin(PerfPhase phase){
+
+  if(!perfPhases)
+    return;
+  if(perfStackSize < PERF_MAXDEPTH)
+    perfStack[perfStackSize] = phase;
+  perfStackSize++;
+  if(perfDepth[phase]++ > 0 || !perfOn)
+    return;
+  perfRead(perfStart[phase]);
+
+}
+
+void perfEnd(PerfPhase phase){
+
+  if(!perfPhases)
+    return;
+  perfStackSize--;
+  if(--perfDepth[phase] > 0 || !perfOn)
+    return;
+  unsigned long long values[PERF_NEVENTS+2];
+  if(perfRead(values)){
+    for(int e=0;e<PERF_NEVENTS+2;e++)
+      perfTotal[phase][e] += values[e] - perfStart[phase][e];
+    perfCalls[phase]++;
+  }
+
+}
+
+void perfPrint(ostream &out){
+
+  if(!perfOn)
+    return;
+
+  out << "Hardware counters:" << endl;
+  for(int p=0;p<PERF_NPHASES;p++){
+    if(perfCalls[p] == 0)
+      continue;
+    // Scale up if the counters were multiplexed with other events
+    double scale = 1.0;
+    if(perfTotal[p][PERF_NEVENTS+1] > 0)
+      scale = 1.0*perfTotal[p][PERF_NEVENTS]/perfTotal[p][PERF_NEVENTS+1];
+    out << "  " << perfPhaseNames[p] << ": " << perfCalls[p] << " calls";
+    for(int e=0;e<PERF_NEVENTS;e++){
+      if(perfSlot[e] < 0)
+        out << ", n/a " << perfEventNames[e];
+      else
+        out << ", " << scale*perfTotal[p][e] << " " << perfEventNames[e];
+      if(e == 1 && perfSlot[e] >= 0 && perfTotal[p][0] > 0)
+        out << " (" << 1.0*perfTotal[p][1]/perfTotal[p][0] << " per cycle)";
+    }
+    out << endl;
+  }
+
+}
@@ -0,0 +1,21 @@
+#ifndef REORDER_H
+#define REORDER_H
+
+#include <string>
+#include <vector>
+using namespace std;
+
+// Renumbering of the nodes before the search, so that nodes that are linked
+// get nearby numbers and their module lookups in the sweeps share cache lines.
+// The links are given as pairs of end nodes, in either direction. On return,
+// perm[i] is the new number of node i:
+//   degree  by decreasing degree, hubs first
+//   rcm     reverse Cuthill-McKee, breadth-first from a node of smallest degree
+//           in each component, neighbors by increasing degree, then reversed
+bool reorderKnown(string mode);
+void reorderNodes(string mode,int Nnode,vector<int> &from,vector<int> &to,vector<int> &perm);
+// Renumber a partition of the original nodes, numbering each module by its
+// first node in the new order as loadPartition does
+void reorderPartition(vector<int> &cluster,vector<int> &perm);
+
+#endif
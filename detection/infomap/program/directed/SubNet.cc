@@ -0,0 +1,53 @@
+#include "SubNet.h"
+
+static vector<int> subLocal;          // Local number of an original node
+static vector<unsigned int> subEpoch; // Extraction that set subLocal
+static unsigned int epoch = 0;
+
+void extractSubNet(Node **orig_node,int Nnode,vector<int> &members,Node **sub_node,double teleportWeight){
+  
+  if(static_cast<int>(subLocal.size()) < Nnode){
+    subLocal.resize(Nnode);
+    subEpoch.resize(Nnode,0);
+  }
+  epoch++;
+  if(epoch == 0){ // Wrapped around, forget all tags
+    fill(subEpoch.begin(),subEpoch.end(),0);
+    epoch = 1;
+  }
+  
+  int sub_Nnode = members.size();
+  for(int j=0;j<sub_Nnode;j++){
+    subLocal[members[j]] = j;
+    subEpoch[members[j]] = epoch;
+  }
+  
+  for(int j=0;j<sub_Nnode;j++){
+    int orig_nr = members[j];
+    int orig_NoutLinks = orig_node[orig_nr]->outLinks.size();
+    int orig_NinLinks = orig_node[orig_nr]->inLinks.size();
+    sub_node[j] = new Node(j,orig_node[orig_nr]->teleportWeight/teleportWeight);
+    sub_node[j]->selfLink = orig_node[orig_nr]->selfLink; // Take care of self-link
+    
+    for(int k=0;k<orig_NoutLinks;k++){
+      int orig_link = orig_node[orig_nr]->outLinks[k].first;
+      double orig_weight = orig_node[orig_nr]->outLinks[k].second;
+      if(subEpoch[orig_link] == epoch && orig_link < orig_nr){
+        int orig_link_newnr = subLocal[orig_link];
+        sub_node[j]->outLinks.push_back(make_pair(orig_link_newnr,orig_weight));
+        sub_node[orig_link_newnr]->inLinks.push_back(make_pair(j,orig_weight));
+      }
+    }
+    
+    for(int k=0;k<orig_NinLinks;k++){
+      int orig_link = orig_node[orig_nr]->inLinks[k].first;
+      double orig_weight = orig_node[orig_nr]->inLinks[k].second;
+      if(subEpoch[orig_link] == epoch && orig_link < orig_nr){
+        int orig_link_newnr = subLocal[orig_link];
+        sub_node[j]->inLinks.push_back(make_pair(orig_link_newnr,orig_weight));
+        sub_node[orig_link_newnr]->outLinks.push_back(make_pair(j,orig_weight));
+      }
+    }
+  }
+  
+}
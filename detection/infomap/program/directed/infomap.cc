@@ -10,14 +10,16 @@ unsigned stou(char *s){
 }
 
 void printTree(string s,multimap<double,treeNode,greater<double> >::iterator it_tM,ofstream *outfile,bool flip);
-void repeated_partition(MTRand *R, Node ***node, GreedyBase *greedy, bool silent,int Ntrials);
-void partition(MTRand *R, Node ***node, GreedyBase *greedy, bool silent);
+void repeated_partition(Random *R, Node ***node, GreedyBase *greedy, bool silent,int Ntrials,vector<int> &initCluster);
+void partition(Random *R, Node ***node, GreedyBase *greedy, bool silent, bool trial);
 
 // Call: trade <seed> <Ntries>
 int main(int argc,char *argv[]){
   
-  if( argc < 4){
-    cout << "Call: ./infomap <seed> <network.net> <# attempts> [selflinks]" << endl;
+  // Options of the form --name follow the positional arguments
+  int Nargs = firstOption(argc,argv);
+  if( Nargs < 4){
+    cout << "Call: ./infomap <seed> <network.net> <# attempts> [selflinks] [--perf] [--alloc-stats] [--link-order shuffle|rotate|tiebreak] [--active-set] [--time-budget seconds] [--patience K] [--abandon] [--init-partition file.clu] [--warm-only] [--reorder degree|rcm] [--mem-limit MB]" << endl;
     exit(-1);
   }
   
@@ -25,7 +27,7 @@ int main(int argc,char *argv[]){
   string line;
   string buf;
   
-  MTRand *R = new MTRand(stou(argv[1]));
+  Random *R = new Random(stou(argv[1]));
 
   string infile = string(argv[2]);
   string networkFile = string(argv[2]);
@@ -33,11 +35,92 @@ int main(int argc,char *argv[]){
   string networkType(infile.begin() + infile.find_last_of("."),infile.end());
 
 	bool includeSelfLinks = false;
-	if(argc == 5)
+	if(Nargs == 5)
 		if(to_string(argv[4]) == "selflinks")
 			includeSelfLinks = true;
 
+  string initFile;
+  bool warmOnly = false;
+  string reorder;
+  double memLimit = 0.0;
+  for(int i=Nargs;i<argc;i++){
+    string option = to_string(argv[i]);
+    if(option == "--perf")
+      perfEnable();
+    else if(option == "--alloc-stats")
+      allocEnable();
+    else if(option == "--active-set")
+      GreedyBase::activeSet = true;
+    else if(option == "--link-order" && i+1 < argc){
+      string order = to_string(argv[++i]);
+      if(order == "shuffle")
+        GreedyBase::linkOrder = LINKS_SHUFFLE;
+      else if(order == "rotate")
+        GreedyBase::linkOrder = LINKS_ROTATE;
+      else if(order == "tiebreak")
+        GreedyBase::linkOrder = LINKS_TIEBREAK;
+      else{
+        cout << "Unknown link order " << order << "...exiting" << endl;
+        exit(-1);
+      }
+    }
+    else if(option == "--time-budget" && i+1 < argc){
+      double seconds = atof(argv[++i]);
+      if(seconds <= 0.0){
+        cout << "The time budget must be positive...exiting" << endl;
+        exit(-1);
+      }
+      budgetSetTime(seconds);
+    }
+    else if(option == "--abandon")
+      budgetSetAbandon();
+    else if(option == "--init-partition" && i+1 < argc)
+      initFile = string(argv[++i]);
+    else if(option == "--warm-only")
+      warmOnly = true;
+    else if(option == "--mem-limit" && i+1 < argc){
+      memLimit = atof(argv[++i]);
+      if(memLimit <= 0.0){
+        cout << "The memory limit must be a positive number of MB...exiting" << endl;
+        exit(-1);
+      }
+    }
+    else if(option == "--reorder" && i+1 < argc){
+      reorder = to_string(argv[++i]);
+      if(!reorderKnown(reorder)){
+        cout << "Unknown node order " << reorder << "...exiting" << endl;
+        exit(-1);
+      }
+    }
+    else if(option == "--patience" && i+1 < argc){
+      int attempts = atoi(argv[++i]);
+      if(attempts <= 0){
+        cout << "The patience must be a positive number of attempts...exiting" << endl;
+        exit(-1);
+      }
+      budgetSetPatience(attempts);
+    }
+    else{
+      cout << "Unknown option " << option << "...exiting" << endl;
+      exit(-1);
+    }
+  }
+  if(warmOnly){
+    if(initFile.empty()){
+      cout << "--warm-only needs --init-partition...exiting" << endl;
+      exit(-1);
+    }
+    Ntrials = 1;
+  }
+  if(Ntrials == 0 && !budgetLimited()){
+    cout << "0 attempts (no limit) needs --time-budget or --patience...exiting" << endl;
+    exit(-1);
+  }
+
+  perfBegin(PERF_LOAD);
   Network network(networkFile);
+  if(memLimit > 0.0)
+    network.store = new LinkStore(networkName,memLimit*1048576.0);
   
   if(networkType == ".net"){
     loadPajekNet(network);    
@@ -48,27 +131,50 @@ int main(int argc,char *argv[]){
 
   int Nnode = network.Nnode;
   
+  // New number of every node in the search, the nodes are numbered back
+  // before the partition is written
+  vector<int> perm(Nnode);
+  if(reorder.empty()){
+    for(int i=0;i<Nnode;i++)
+      perm[i] = i;
+  }
+  else{
+    vector<int> from,to;
+    LinkReader links(network);
+    int linkFrom,linkTo;
+    double weight;
+    while(links.next(linkFrom,linkTo,weight))
+      if(weight > 0.0 && linkFrom != linkTo){
+        from.push_back(linkFrom);
+        to.push_back(linkTo);
+      }
+    reorderNodes(reorder,Nnode,from,to,perm);
+  }
+  vector<int> inv(Nnode);
+  for(int i=0;i<Nnode;i++)
+    inv[perm[i]] = i;
+  
   /////////// Partition network /////////////////////
   Node **node = new Node*[Nnode];
   for(int i=0;i<Nnode;i++){
-    node[i] = new Node(i,network.nodeWeights[i]/network.totNodeWeights);
+    node[i] = new Node(i,network.nodeWeights[inv[i]]/network.totNodeWeights);
   }
   
   int NselfLinks = 0;
-  for(map<pair<int,int>,double>::iterator it = network.Links.begin(); it != network.Links.end(); it++){
+  LinkReader links(network);
+  int from,to;
+  double weight;
+  while(links.next(from,to,weight)){
     
-    int from = it->first.first;
-    int to = it->first.second;
-    double weight = it->second;
     if(weight > 0.0){
       if(from == to){
         NselfLinks++;
 				if(includeSelfLinks)
-					node[from]->selfLink += weight;
+					node[perm[from]]->selfLink += weight;
       }
       else{
-        node[from]->outLinks.push_back(make_pair(to,weight));
-        node[to]->inLinks.push_back(make_pair(from,weight));
+        node[perm[from]]->outLinks.push_back(make_pair(perm[to],weight));
+        node[perm[to]]->inLinks.push_back(make_pair(perm[from],weight));
       }
     }
   }
@@ -80,6 +186,9 @@ int main(int argc,char *argv[]){
 
   //Swap vector to free memory
   map<pair<int,int>,double>().swap(network.Links);
+  delete network.store;
+  network.store = NULL;
+  perfEnd(PERF_LOAD);
     
   // Initiation
   GreedyBase* greedy;
@@ -88,12 +197,28 @@ int main(int argc,char *argv[]){
   
   vector<double> size(Nnode);
   for(int i=0;i<Nnode;i++)
-    size[i] = node[i]->size;
+    size[i] = node[perm[i]]->size;
 
+  vector<int> initCluster;
+  if(!initFile.empty()){
+    loadPartition(initFile,Nnode,initCluster);
+    if(!reorder.empty())
+      reorderPartition(initCluster,perm);
+  }
+  
   cout << "Now partition the network:" << endl;
-  repeated_partition(R,&node,greedy,false,Ntrials);
+  repeated_partition(R,&node,greedy,false,Ntrials,initCluster);
   int Nmod = greedy->Nnode;
+  if(!reorder.empty()){
+    for(int i=0;i<Nmod;i++){
+      int Nmembers = node[i]->members.size();
+      for(int j=0;j<Nmembers;j++)
+        node[i]->members[j] = inv[node[i]->members[j]];
+    }
+  }
   cout << "Done! Code length " << greedy->codeLength/log(2.0) << " in " << Nmod << " modules." << endl; 
+  perfPrint(cout);
+  allocPrint(cout);
       
   // Order links by size
   vector<double> exit(Nmod,0.0);
@@ -224,16 +349,20 @@ int main(int argc,char *argv[]){
   delete R;
 }
 
-void partition(MTRand *R, Node ***node, GreedyBase *greedy, bool silent){
+void partition(Random *R, Node ***node, GreedyBase *greedy, bool silent, bool trial){
   
   int Nnode = greedy->Nnode;
+  perfBegin(PERF_COPY);
   Node **cpy_node = new Node*[Nnode];
   for(int i=0;i<Nnode;i++){
     cpy_node[i] = new Node();
     cpyNode(cpy_node[i],(*node)[i]);
   }
+  perfEnd(PERF_COPY);
   
   int iteration = 0;
+  double firstCodeLength = 0.0;
+  bool abandoned = false;
   double outer_oldCodeLength;
   do{
     outer_oldCodeLength = greedy->codeLength;
@@ -241,14 +370,18 @@ void partition(MTRand *R, Node ***node, GreedyBase *greedy, bool silent){
     
     if((iteration > 0) && (iteration % 2 == 0) && (greedy->Nnode > 1)){  // Partition the partition
       
+      PerfRegion region(PERF_SUBMODULE);
+      
       if(!silent)
         cout << "Iteration " << iteration+1 << ", moving ";
       
+      perfBegin(PERF_COPY);
       Node **rpt_node = new Node*[Nnode];
       for(int i=0;i<Nnode;i++){
         rpt_node[i] = new Node();
         cpyNode(rpt_node[i],cpy_node[i]);
       }
+      perfEnd(PERF_COPY);
       vector<int> subMoveTo(Nnode);
       vector<int> moveTo(Nnode);
       int subModIndex = 0;
@@ -259,49 +392,15 @@ void partition(MTRand *R, Node ***node, GreedyBase *greedy, bool silent){
         
         if(sub_Nnode > 1){
           Node **sub_node = new Node*[sub_Nnode]; 
-          set<int> sub_mem;
-          for(int j=0;j<sub_Nnode;j++)
-            sub_mem.insert((*node)[i]->members[j]);
-          set<int>::iterator it_mem = sub_mem.begin();
-          vector<int> sub_renumber = vector<int>(Nnode);
-          vector<int> sub_rev_renumber = vector<int>(sub_Nnode);
-          for(int j=0;j<sub_Nnode;j++){
-            int orig_nr = (*it_mem);
-            int orig_NoutLinks = cpy_node[orig_nr]->outLinks.size();
-            int orig_NinLinks = cpy_node[orig_nr]->inLinks.size();
-            sub_renumber[orig_nr] = j;
-            sub_rev_renumber[j] = orig_nr;
-            sub_node[j] = new Node(j,cpy_node[orig_nr]->teleportWeight/(*node)[i]->teleportWeight);
-            sub_node[j]->selfLink =  cpy_node[orig_nr]->selfLink; // Take care of self-link
-            for(int k=0;k<orig_NoutLinks;k++){
-              int orig_link = cpy_node[orig_nr]->outLinks[k].first;
-              int orig_link_newnr = sub_renumber[orig_link];
-              double orig_weight = cpy_node[orig_nr]->outLinks[k].second;
-              if(orig_link < orig_nr){
-                if(sub_mem.find(orig_link) != sub_mem.end()){
-                  sub_node[j]->outLinks.push_back(make_pair(orig_link_newnr,orig_weight));
-                  sub_node[orig_link_newnr]->inLinks.push_back(make_pair(j,orig_weight));
-                }
-              }
-            }
-            for(int k=0;k<orig_NinLinks;k++){
-              int orig_link = cpy_node[orig_nr]->inLinks[k].first;
-              int orig_link_newnr = sub_renumber[orig_link];
-              double orig_weight = cpy_node[orig_nr]->inLinks[k].second;
-              if(orig_link < orig_nr){
-                if(sub_mem.find(orig_link) != sub_mem.end()){
-                  sub_node[j]->inLinks.push_back(make_pair(orig_link_newnr,orig_weight));
-                  sub_node[orig_link_newnr]->outLinks.push_back(make_pair(j,orig_weight));
-                }
-              }
-            }
-            it_mem++;
-          }
+          vector<int> sub_rev_renumber((*node)[i]->members);
+          sort(sub_rev_renumber.begin(),sub_rev_renumber.end());
+          extractSubNet(cpy_node,Nnode,sub_rev_renumber,sub_node,(*node)[i]->teleportWeight);
           
+          Random sub_R = R->split(); // Own stream for each submodule
           GreedyBase* sub_greedy;
-          sub_greedy = new Greedy(R,sub_Nnode,sub_node,sub_Nnode);
+          sub_greedy = new Greedy(&sub_R,sub_Nnode,sub_node,sub_Nnode);
           sub_greedy->initiate();
-          partition(R,&sub_node,sub_greedy,true);
+          partition(&sub_R,&sub_node,sub_greedy,true,false);
           for(int j=0;j<sub_greedy->Nnode;j++){
             int Nmembers = sub_node[j]->members.size();
             for(int k=0;k<Nmembers;k++){
@@ -350,11 +449,13 @@ void partition(MTRand *R, Node ***node, GreedyBase *greedy, bool silent){
       if(!silent)
         cout << "Iteration " << iteration+1 << ", moving " << Nnode << " nodes, looping ";
       
+      perfBegin(PERF_COPY);
       Node **rpt_node = new Node*[Nnode];
       for(int i=0;i<Nnode;i++){
         rpt_node[i] = new Node();
         cpyNode(rpt_node[i],cpy_node[i]);
       }
+      perfEnd(PERF_COPY);
       
       vector<int>moveTo(Nnode);
       for(int i=0;i<greedy->Nnode;i++){
@@ -390,13 +491,22 @@ void partition(MTRand *R, Node ***node, GreedyBase *greedy, bool silent){
       bool moved = true;
       int Nloops = 0;
       int count = 0;
+      vector<int> active; // Nodes to try in the next sweep
+      if(GreedyBase::activeSet){
+        active.resize(greedy->Nnode);
+        for(int i=0;i<greedy->Nnode;i++)
+          active[i] = i;
+      }
       while(moved){
         moved = false;
         double inner_oldCodeLength = greedy->codeLength;
-        greedy->move(moved);
+        if(GreedyBase::activeSet)
+          greedy->moveSet(active,moved);
+        else
+          greedy->move(moved);
         Nloops++;
         count++;
-        if(fabs(greedy->codeLength - inner_oldCodeLength) < 1.0e-10)
+        if(fabs(greedy->codeLength - inner_oldCodeLength) < 1.0e-10 || budgetSpent() || (GreedyBase::activeSet && active.empty()))
           moved = false;
         
         if(count == 10){	  
@@ -410,13 +520,26 @@ void partition(MTRand *R, Node ***node, GreedyBase *greedy, bool silent){
       if(!silent)
         cout << Nloops << " ";
       
-    } while(oldCodeLength - greedy->codeLength >  1.0e-10);
+    } while(oldCodeLength - greedy->codeLength >  1.0e-10 && !budgetSpent());
     
     iteration++;
     if(!silent)
       cout << "times between mergings to code length " <<  greedy->codeLength/log(2.0) << " in " << greedy->Nmod << " modules." << endl;
     
-  } while(outer_oldCodeLength - greedy->codeLength > 1.0e-10);
+    // Give up attempts that cannot be expected to beat the best one
+    if(trial && iteration == 1){
+      firstCodeLength = greedy->codeLength;
+      if(budgetHopeless(firstCodeLength)){
+        if(!silent)
+          cout << "Abandoning the attempt, it is not expected to beat the best code length." << endl;
+        abandoned = true;
+        break;
+      }
+    }
+    
+  } while(outer_oldCodeLength - greedy->codeLength > 1.0e-10 && !budgetSpent());
+  if(trial && !abandoned)
+    budgetRecordTrial(firstCodeLength,greedy->codeLength);
   
   for(int i=0;i<Nnode;i++)
     delete cpy_node[i];
@@ -424,34 +547,47 @@ void partition(MTRand *R, Node ***node, GreedyBase *greedy, bool silent){
   
 }
 
-void repeated_partition(MTRand *R, Node ***node, GreedyBase *greedy, bool silent,int Ntrials){
+void repeated_partition(Random *R, Node ***node, GreedyBase *greedy, bool silent,int Ntrials,vector<int> &initCluster){
   
   double shortestCodeLength = 1000.0;
   int Nnode = greedy->Nnode;
   vector<int> cluster(Nnode);
   
-  for(int trial = 0; trial<Ntrials;trial++){
+  int Nstale = 0; // Attempts since the last improvement
+  for(int trial = 0; budgetNextTrial(trial,Ntrials,Nstale,silent); trial++){
     
     if(!silent)
-      cout << "Attempt " << trial+1 << "/" << Ntrials << endl;
+      cout << "Attempt " << trial+1 << (Ntrials > 0 ? "/" + to_string(Ntrials) : string("")) << endl;
     
+    perfBegin(PERF_COPY);
     Node **cpy_node = new Node*[Nnode];
     for(int i=0;i<Nnode;i++){
       cpy_node[i] = new Node();
       cpyNode(cpy_node[i],(*node)[i]);
     }
+    perfEnd(PERF_COPY);
     
     greedy->Nnode = Nnode;
     greedy->Nmod = Nnode;
     greedy->Ndanglings = 0;
     greedy->node = cpy_node;
     greedy->calibrate();
+    // The first attempt starts from the initial partition, if any
+    if(trial == 0 && !initCluster.empty())
+      greedy->determMove(initCluster);
     
-    partition(R,&cpy_node,greedy,silent);
+    Random trial_R = R->split(trial); // Own stream for each trial
+    greedy->setRandom(&trial_R);
+    partition(&trial_R,&cpy_node,greedy,silent,true);
     
+    if(greedy->codeLength < shortestCodeLength - 1.0e-10)
+      Nstale = 0;
+    else
+      Nstale++;
     if(greedy->codeLength < shortestCodeLength){
       
       shortestCodeLength = greedy->codeLength;
+      budgetOffer(shortestCodeLength);
       
       // Store best partition
       for(int i=0;i<greedy->Nnode;i++){
@@ -468,6 +604,8 @@ void repeated_partition(MTRand *R, Node ***node, GreedyBase *greedy, bool silent
     
   }
   
+  greedy->setRandom(R);
+  
   // Commit best partition
   greedy->Nnode = Nnode;
   greedy->Nmod = Nnode;
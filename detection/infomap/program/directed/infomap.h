@@ -7,10 +7,16 @@
 #include <sstream>
 #include <fstream>
 #include <iomanip>
-#include "MersenneTwister.h"
+#include "Random.h"
 #include "GreedyBase.h" 
 #include "Greedy.h" 
 #include "Node.h" 
+#include "PerfCounters.h"
+#include "AllocTracker.h"
+#include "Budget.h"
+#include "Reorder.h"
+#include "LinkStore.h"
+#include "SubNet.h"
 #define PI 3.14159265
 using namespace std;
 
@@ -28,13 +34,47 @@ public:
   vector<string> nodeNames;
   vector<double> nodeWeights;
   map<pair<int,int>,double> Links;
+  LinkStore *store; // Links on disk instead of in Links, if not NULL
   
 };
 
 Network::Network(string netname){
   name = netname;
+  store = NULL;
 }
 
+// Links of the network in order of (from,to), from the map or from the
+// memory-mapped file of the link store
+class LinkReader{
+ public:
+  LinkReader(Network &network) : net(network), it(network.Links.begin()), from(0), k(0) {}
+  bool next(int &linkFrom,int &linkTo,double &weight){
+    if(net.store == NULL){
+      if(it == net.Links.end())
+        return false;
+      linkFrom = it->first.first;
+      linkTo = it->first.second;
+      weight = it->second;
+      it++;
+      return true;
+    }
+    while(from < net.Nnode && k == net.store->end(from))
+      from++;
+    if(from == net.Nnode)
+      return false;
+    linkFrom = from;
+    linkTo = net.store->to(k);
+    weight = net.store->weight(k);
+    k++;
+    return true;
+  }
+ private:
+  Network &net;
+  map<pair<int,int>,double>::iterator it;
+  int from;
+  long long k;
+};
+
 class treeNode{
  public:
   double exit;
@@ -49,6 +89,60 @@ inline std::string to_string (const T& t){
   return ss.str();
 }
 
+// Index of the first --option argument, or argc if there are none
+int firstOption(int argc,char *argv[]){
+  for(int i=1;i<argc;i++)
+    if(strncmp(argv[i],"--",2) == 0)
+      return i;
+  return argc;
+}
+
+// Read a partition in Pajek's .clu format, as written by the programs, and
+// number every module by its first node. Moving each node to the module of
+// its first member never fills a module that has been emptied, as determMove
+// expects.
+void loadPartition(string file,int Nnode,vector<int> &cluster){
+  
+  cout << "Reading initial partition " << file << "..." << flush;
+  ifstream clu(file.c_str());
+  if(!clu){
+    cout << "cannot open the file...exiting" << endl;
+    exit(-1);
+  }
+  string line;
+  string buf;
+  istringstream ss;
+  int Nclu = -1;
+  while(Nclu < 0 && getline(clu,line)){
+    ss.clear();
+    ss.str(line);
+    buf = "";
+    ss >> buf;
+    if(buf == "*Vertices" || buf == "*vertices" || buf == "*VERTICES")
+      ss >> Nclu;
+  }
+  if(Nclu != Nnode){
+    cout << "the partition has " << Nclu << " nodes, the network " << Nnode << "...exiting" << endl;
+    exit(-1);
+  }
+  
+  cluster = vector<int>(Nnode);
+  map<int,int> first;
+  for(int i=0;i<Nnode;i++){
+    int mod;
+    if(!(clu >> mod)){
+      cout << "the partition ends after " << i << " nodes...exiting" << endl;
+      exit(-1);
+    }
+    map<int,int>::iterator it = first.find(mod);
+    if(it == first.end())
+      it = first.insert(make_pair(mod,i)).first;
+    cluster[i] = it->second;
+  }
+  cout << "done! (" << first.size() << " modules)" << endl;
+  
+}
+
 void cpyNode(Node *newNode,Node *oldNode){
   
   newNode->index = oldNode->index;
@@ -189,9 +283,13 @@ void loadPajekNet(Network &network){
     linkEnd1--; // Nodes start at 1, but C++ arrays at 0.
     linkEnd2--;
      
-    newLinkWeight = network.Links[make_pair(linkEnd1,linkEnd2)] += linkWeight;
-    if(newLinkWeight > linkWeight)
-      NdoubleLinks++;
+    if(network.store != NULL)
+      network.store->add(linkEnd1,linkEnd2,linkWeight);
+    else{
+      newLinkWeight = network.Links[make_pair(linkEnd1,linkEnd2)] += linkWeight;
+      if(newLinkWeight > linkWeight)
+        NdoubleLinks++;
+    }
 
   //   // Aggregate link weights if they are definied more than once
   //   map<int,map<int,double> >::iterator fromLink_it = network.Links.find(linkEnd1);
@@ -217,7 +315,13 @@ void loadPajekNet(Network &network){
 
   net.close();
 
-  network.Nlinks = network.Links.size();
+  if(network.store != NULL){
+    network.store->finish(network.Nnode,NULL);
+    network.Nlinks = network.store->Nlinks;
+    NdoubleLinks = network.store->NdoubleLinks;
+  }
+  else
+    network.Nlinks = network.Links.size();
   
   cout << "done! (found " << network.Nnode << " nodes and " << network.Nlinks << " links";
   if(NdoubleLinks > 0)
@@ -267,9 +371,13 @@ void loadLinkList(Network &network){
 			Nodes.insert(linkEnd1);
 			Nodes.insert(linkEnd2);
       
-      newLinkWeight = network.Links[make_pair(linkEnd1,linkEnd2)] += linkWeight;
-			if(newLinkWeight > linkWeight)
-        NdoubleLinks++;
+      if(network.store != NULL)
+        network.store->add(linkEnd1,linkEnd2,linkWeight);
+      else{
+        newLinkWeight = network.Links[make_pair(linkEnd1,linkEnd2)] += linkWeight;
+        if(newLinkWeight > linkWeight)
+          NdoubleLinks++;
+      }
     
     }
     
@@ -278,8 +386,9 @@ void loadLinkList(Network &network){
   net.close();
   
   network.Nnode = Nodes.size();
-  network.Nlinks = network.Links.size();
   network.nodeNames = vector<string>(network.Nnode);
+  network.nodeWeights = vector<double>(network.Nnode,1.0);
+  network.totNodeWeights = network.Nnode;
   
   int nodeCounter = 0;
   map<int,int> renumber;
@@ -292,7 +401,12 @@ void loadLinkList(Network &network){
     nodeCounter++;	
   }	
   
-  if(renum){
+  if(network.store != NULL){
+    network.store->finish(network.Nnode,renum ? &renumber : NULL);
+    network.Nlinks = network.store->Nlinks;
+    NdoubleLinks = network.store->NdoubleLinks;
+  }
+  else if(renum){
         
     map<pair<int,int>,double> newLinks;
     for(map<pair<int,int>,double>::iterator it = network.Links.begin(); it != network.Links.end(); it++)
@@ -301,6 +415,8 @@ void loadLinkList(Network &network){
     network.Links.swap(newLinks);
     
   }
+  if(network.store == NULL)
+    network.Nlinks = network.Links.size();
   
   cout << "done! (found " << network.Nnode << " nodes and " << network.Nlinks << " links";
   if(NdoubleLinks > 0)
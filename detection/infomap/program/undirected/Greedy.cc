@@ -1,4 +1,11 @@
 #include "Greedy.h"
+#include "PerfCounters.h"
+
+LinkOrder GreedyBase::linkOrder = LINKS_SHUFFLE;
+bool GreedyBase::activeSet = false;
+
+// Links ahead of the current one whose module is fetched into cache
+static const int PREFETCH_AHEAD = 8;
 
 Greedy::~Greedy(){
   
@@ -6,7 +13,7 @@ Greedy::~Greedy(){
 	
 }
 
-Greedy::Greedy(MTRand *RR,int nnode,double deg,Node **ah){
+Greedy::Greedy(Random *RR,int nnode,double deg,Node **ah){
 	
   R = RR;
   Nnode = nnode;  
@@ -15,163 +22,333 @@ Greedy::Greedy(MTRand *RR,int nnode,double deg,Node **ah){
   invDegree = 1.0/degree;
   log2 = log(2.0);
   Nmod = Nnode;
+  offset = 1;
+  queueStamp = 0;
+  // Code length change per unit of weight, at most
+  weightScale = invDegree*(fabs(log(invDegree))/log2 + 2.0);
+  drift = 0.0;
 	
 }
 
 void Greedy::move(bool &moved){
 	
+  PerfRegion region(PERF_MOVE);
+  
   // Generate random enumeration of nodes
   vector<int> randomOrder(Nnode);
   for(int i=0;i<Nnode;i++)
     randomOrder[i] = i;
-  for(int i=0;i<Nnode-1;i++){
-    int randPos = i + R->randInt(Nnode-i-1);
-    int tmp = randomOrder[i];
-    randomOrder[i] = randomOrder[randPos];
-    randomOrder[randPos] = tmp;
-  }
+  R->shuffle(&randomOrder[0],Nnode);
   
-  unsigned int offset = 1;    
-  vector<unsigned int> redirect(Nnode,0);
-  vector<pair<int,double> > wNtoM(Nnode);
+  scratch();
   for(int k=0;k<Nnode;k++){
-    
     // Pick nodes in random order
-    int flip = randomOrder[k]; 
-		
-    // Reset offset when int overflows
-    if(offset > INT_MAX){ 
-      for(int j=0;j<Nnode;j++)
-				redirect[j] = 0;
-      offset = 1;
-    }    
-		
-    // Create vector with module links
-    int Nlinks = node[flip]->links.size();
-    int NmodLinks = 0;
-    for(int j=0; j<Nlinks; j++){
-      int nb_M = node[node[flip]->links[j].first]->index;
-      double nb_w = node[flip]->links[j].second;
+    if(moveNode(randomOrder[k]))
+      moved = true;
+  }
+  
+  //cout << "Code length = " << codeLength << endl;
+	
+}
+
+void Greedy::moveSet(vector<int> &active,bool &moved){
+  
+  PerfRegion region(PERF_MOVE);
+  
+  int Nactive = active.size();
+  if(Nactive > 1)
+    R->shuffle(&active[0],Nactive);
+  
+  scratch();
+  if(++queueStamp == 0){ 
+    for(int i=0;i<Nnode;i++)
+      queued[i] = 0;
+    queueStamp = 1;
+  }
+  
+  // Neighbors of the nodes that change module are tried in the next sweep
+  vector<int> next;
+  for(int k=0;k<Nactive;k++){
+    int flip = active[k];
+    if(moveNode(flip)){
+      moved = true;
+      LinkCursor link(node[flip]->links);
+      int nb;
+      double nb_w;
+      while(link.next(nb,nb_w)){
+        if(queued[nb] != queueStamp){
+          queued[nb] = queueStamp;
+          next.push_back(nb);
+        }
+      }
+    }
+  }
+  active.swap(next);
+  
+}
+
+void Greedy::scratch(void){
+  
+  if(static_cast<int>(redirect.size()) < Nnode){
+    vector<unsigned int>(Nnode,0).swap(redirect);
+    vector<pair<int,double> >(Nnode).swap(wNtoM);
+    vector<unsigned int>(Nnode,0).swap(queued);
+    offset = 1;
+  }
+  
+}
+
+#if defined(VARINT_LINKS)
+
+// As below, for the links decoded into wNtoM, with j the link being read
+void Greedy::prefetchModule(int j,int Nlinks){
+  
+  if(j + PREFETCH_AHEAD < Nlinks)
+    __builtin_prefetch(&node_index[wNtoM[j + PREFETCH_AHEAD].first]);
+  if(j + PREFETCH_AHEAD/2 < Nlinks){
+    int ahead_M = node_index[wNtoM[j + PREFETCH_AHEAD/2].first];
+    __builtin_prefetch(&redirect[ahead_M]);
+    __builtin_prefetch(&mod_exit[ahead_M]);
+    __builtin_prefetch(&mod_degree[ahead_M]);
+  }
+  
+}
+
+#else
+
+// Fetch the module of the neighbor at cursor far into cache, and for the
+// neighbor at cursor near, whose module is then in cache, its entries in
+// redirect and the module arrays read for every candidate move
+void Greedy::prefetchModule(LinkCursor &far,LinkCursor &near){
+  
+  int nb;
+  double nb_w;
+  if(far.next(nb,nb_w))
+    __builtin_prefetch(&node_index[nb]);
+  if(near.next(nb,nb_w)){
+    int ahead_M = node_index[nb];
+    __builtin_prefetch(&redirect[ahead_M]);
+    __builtin_prefetch(&mod_exit[ahead_M]);
+    __builtin_prefetch(&mod_degree[ahead_M]);
+  }
+  
+}
+
+#endif
+
+bool Greedy::moveNode(int flip){
+  
+  // Reset offset when int overflows
+  if(offset > INT_MAX){ 
+    for(unsigned int j=0;j<redirect.size();j++)
+      redirect[j] = 0;
+    offset = 1;
+  }    
+  
+  // Create vector with module links, prefetching PREFETCH_AHEAD links on
+  LinkList &links = node[flip]->links;
+  int NmodLinks = 0;
+  int nb;
+  double nb_w;
+#if defined(VARINT_LINKS)
+  // Decode the links once into wNtoM and merge them into module links in
+  // place, no entry is written before it has been read
+  int Nlinks = links.size();
+  if(Nlinks >= static_cast<int>(wNtoM.size()))
+    wNtoM.resize(Nlinks+1);
+  LinkCursor link(links);
+  for(int j=0;link.next(nb,nb_w);j++){
+    wNtoM[j].first = nb;
+    wNtoM[j].second = nb_w;
+  }
+  for(int j=0;j<Nlinks;j++){
+    prefetchModule(j,Nlinks);
+    nb = wNtoM[j].first;
+    nb_w = wNtoM[j].second;
+#else
+  LinkCursor link(links),far(links),near(links);
+  far.skip(PREFETCH_AHEAD);
+  near.skip(PREFETCH_AHEAD/2);
+  while(link.next(nb,nb_w)){
+    prefetchModule(far,near);
+#endif
+    int nb_M = node_index[nb];
 			
-      if(redirect[nb_M] >= offset){
+    if(redirect[nb_M] >= offset){
 				wNtoM[redirect[nb_M] - offset].second += nb_w;
-      }
-      else{
+    }
+    else{
 				redirect[nb_M] = offset + NmodLinks;
 				wNtoM[NmodLinks].first = nb_M;
 				wNtoM[NmodLinks].second = nb_w;
 				NmodLinks++;
-      }
-    }    
+    }
+  }    
 		
-    // Calculate exit weight to own module
-    int fromM = node[flip]->index; // 
-    double wfromM = 0.0;
-    if(redirect[fromM] >= offset)
-      wfromM = wNtoM[redirect[fromM] - offset].second;
-    
-    // Option to move to empty module (if node not already alone)
-    if(mod_members[fromM] > static_cast<int>(node[flip]->members.size())){
-      if(Nempty > 0){
+  // Calculate exit weight to own module
+  int fromM = node_index[flip];
+  double wfromM = 0.0;
+  if(redirect[fromM] >= offset)
+    wfromM = wNtoM[redirect[fromM] - offset].second;
+  
+  // Option to move to empty module (if node not already alone)
+  if(mod_members[fromM] > node_members[flip]){
+    if(Nempty > 0){
 				wNtoM[NmodLinks].first = mod_empty[Nempty-1];
 				wNtoM[NmodLinks].second = 0;
 				NmodLinks++;
-      }
     }
+  }
 		
-    // Randomize link order
-    for(int j=0;j<NmodLinks-1;j++){
-      int randPos = j + R->randInt(NmodLinks-j-1);
-      int tmp_M = wNtoM[j].first;
-      double tmp_w = wNtoM[j].second;
-      wNtoM[j].first = wNtoM[randPos].first;
-      wNtoM[j].second = wNtoM[randPos].second;
-      wNtoM[randPos].first = tmp_M;
-      wNtoM[randPos].second = tmp_w;
-    }
+  // Randomize link order for optimized search
+  int start = 0;
+  int Nties = 1;
+  if(linkOrder == LINKS_SHUFFLE)
+    R->shuffle(&wNtoM[0],NmodLinks);
+  else if(linkOrder == LINKS_ROTATE && NmodLinks > 1)
+    start = R->randBelow(NmodLinks);
 		
-    int bestM = fromM;
-    double best_weight = 0.0;
-    double best_delta = 0.0;
+  int bestM = fromM;
+  double best_weight = 0.0;
+  double best_delta = 0.0;
+  
+  // Find the move that minimizes the description length
+  for (int l=0; l<NmodLinks; l++) {
+    int j = l + start;
+    if(j >= NmodLinks)
+      j -= NmodLinks;
     
-    // Find the move that minimizes the description length
-    for (int j=0; j<NmodLinks; j++) {
-      
-      int toM = wNtoM[j].first;
-      double wtoM = wNtoM[j].second;
-      
-      if(toM != fromM){
+    int toM = wNtoM[j].first;
+    double wtoM = wNtoM[j].second;
+    
+    if(toM != fromM){
 				
+				double flip_exit = node_exit[flip];
+				double flip_degree = node_degree[flip];
 				double delta_exit = plogp(exitDegree - 2*wtoM + 2*wfromM) - exit;
 				
 				double delta_exit_log_exit = - plogp(mod_exit[fromM]) - plogp(mod_exit[toM]) \
-				+ plogp(mod_exit[fromM] - node[flip]->exit + 2*wfromM) + plogp(mod_exit[toM] + node[flip]->exit - 2*wtoM);
+				+ plogp(mod_exit[fromM] - flip_exit + 2*wfromM) + plogp(mod_exit[toM] + flip_exit - 2*wtoM);
 				
 				double delta_degree_log_degree = - plogp(mod_exit[fromM] + mod_degree[fromM]) - plogp(mod_exit[toM] + mod_degree[toM]) \
-				+ plogp(mod_exit[fromM] + mod_degree[fromM] - node[flip]->exit - node[flip]->degree + 2*wfromM) \
-				+ plogp(mod_exit[toM] + mod_degree[toM] + node[flip]->exit + node[flip]->degree - 2*wtoM);
+				+ plogp(mod_exit[fromM] + mod_degree[fromM] - flip_exit - flip_degree + 2*wfromM) \
+				+ plogp(mod_exit[toM] + mod_degree[toM] + flip_exit + flip_degree - 2*wtoM);
 				
 				double deltaL = delta_exit - 2.0*delta_exit_log_exit + delta_degree_log_degree;
 				
-				if(deltaL < best_delta){
+				bool better = deltaL < best_delta;
+				if(linkOrder == LINKS_TIEBREAK){
+					// Pick uniformly among equally good moves
+					if(better)
+						Nties = 1;
+					else if(deltaL == best_delta && bestM != fromM)
+						better = (R->randBelow(++Nties) == 0);
+				}
+				if(better){
 					bestM = toM;
 					best_weight = wtoM;
 					best_delta = deltaL;  
 				}
 				
-      }
     }
-    
-    // Make best possible move
-    if(bestM != fromM){
+  }
+  
+  // Make best possible move
+  if(bestM != fromM){
 			
-      //Update empty module vector
-      if(mod_members[bestM] == 0){
+    //Update empty module vector
+    if(mod_members[bestM] == 0){
 				Nempty--;
-      }
-      if(mod_members[fromM] == static_cast<int>(node[flip]->members.size())){
+    }
+    if(mod_members[fromM] == node_members[flip]){
 				mod_empty[Nempty] = fromM;
 				Nempty++;
-      }
-			
-      exitDegree -= mod_exit[fromM] + mod_exit[bestM];
-      exit_log_exit -= plogp(mod_exit[fromM]) + plogp(mod_exit[bestM]);
-      degree_log_degree -= plogp(mod_exit[fromM] + mod_degree[fromM]) + plogp(mod_exit[bestM] + mod_degree[bestM]); 
-			
-      mod_exit[fromM] -= node[flip]->exit - 2*wfromM;
-      mod_degree[fromM] -= node[flip]->degree;
-      mod_members[fromM] -= node[flip]->members.size();
-      mod_exit[bestM] += node[flip]->exit - 2*best_weight;
-      mod_degree[bestM] += node[flip]->degree;
-      mod_members[bestM] += node[flip]->members.size();
+    }
 			
-      exitDegree += mod_exit[fromM] + mod_exit[bestM];
-      exit_log_exit += plogp(mod_exit[fromM]) + plogp(mod_exit[bestM]);
-      degree_log_degree += plogp(mod_exit[fromM] + mod_degree[fromM]) + plogp(mod_exit[bestM] + mod_degree[bestM]); 
-      
-      exit = plogp(exitDegree);
-      
-      codeLength = exit - 2.0*exit_log_exit + degree_log_degree - nodeDegree_log_nodeDegree;
-      
-      node[flip]->index = bestM;
-      moved = true;
+    shift(flip,fromM,bestM,wfromM,best_weight);
+    
+    node[flip]->index = bestM;
+    node_index[flip] = bestM;
 			
-    }
-		
-    offset += Nnode;
-		
   }
   
-  //cout << "Code length = " << codeLength << endl;
-	
+  offset += Nnode;
+  
+  return bestM != fromM;
+  
+}
+
+// Add x to the sum s and keep the rounding error in c (Neumaier). c is folded
+// back so that s stays the double closest to the exact sum, and only the
+// rounding of c itself can drift.
+void Greedy::compAdd(double &s,double &c,double x,double scale){
+  
+  double t = s + x;
+  if(fabs(s) >= fabs(x))
+    c += (s - t) + x;
+  else
+    c += (x - t) + s;
+  s = t + c;
+  c -= s - t;
+  drift += scale*DBL_EPSILON*(fabs(c) + DBL_EPSILON*fabs(s));
+  
+}
+
+// Move node i from module fromM to toM, with link weights wfromM and wtoM
+// to the two modules, and update the terms of the map equation
+void Greedy::shift(int i,int fromM,int toM,double wfromM,double wtoM){
+  
+  compAdd(exitDegree,exitDegree_c,-mod_exit[fromM],weightScale);
+  compAdd(exitDegree,exitDegree_c,-mod_exit[toM],weightScale);
+  compAdd(exit_log_exit,exit_log_exit_c,-plogp(mod_exit[fromM]),2.0);
+  compAdd(exit_log_exit,exit_log_exit_c,-plogp(mod_exit[toM]),2.0);
+  compAdd(degree_log_degree,degree_log_degree_c,-plogp(mod_exit[fromM] + mod_degree[fromM]),1.0);
+  compAdd(degree_log_degree,degree_log_degree_c,-plogp(mod_exit[toM] + mod_degree[toM]),1.0);
+  
+  compAdd(mod_exit[fromM],mod_exit_c[fromM],-(node_exit[i] - 2*wfromM),weightScale);
+  compAdd(mod_degree[fromM],mod_degree_c[fromM],-node_degree[i],weightScale);
+  mod_members[fromM] -= node_members[i];
+  compAdd(mod_exit[toM],mod_exit_c[toM],node_exit[i] - 2*wtoM,weightScale);
+  compAdd(mod_degree[toM],mod_degree_c[toM],node_degree[i],weightScale);
+  mod_members[toM] += node_members[i];
+  
+  compAdd(exitDegree,exitDegree_c,mod_exit[fromM],weightScale);
+  compAdd(exitDegree,exitDegree_c,mod_exit[toM],weightScale);
+  compAdd(exit_log_exit,exit_log_exit_c,plogp(mod_exit[fromM]),2.0);
+  compAdd(exit_log_exit,exit_log_exit_c,plogp(mod_exit[toM]),2.0);
+  compAdd(degree_log_degree,degree_log_degree_c,plogp(mod_exit[fromM] + mod_degree[fromM]),1.0);
+  compAdd(degree_log_degree,degree_log_degree_c,plogp(mod_exit[toM] + mod_degree[toM]),1.0);
+  
+  exit = plogp(exitDegree);
+  
+  codeLength = exit - 2.0*exit_log_exit + degree_log_degree - nodeDegree_log_nodeDegree;
+  
+}
+
+bool Greedy::drifted(void){
+  return drift > 1.0e-12;
+}
+
+void Greedy::resetDrift(void){
+  
+  vector<double>(mod_exit.size(),0.0).swap(mod_exit_c);
+  vector<double>(mod_degree.size(),0.0).swap(mod_degree_c);
+  exitDegree_c = 0.0;
+  exit_log_exit_c = 0.0;
+  degree_log_degree_c = 0.0;
+  drift = 0.0;
+  
 }
 
 void Greedy::initiate(void){
   
   for(int i=0;i<Nnode;i++){
     double Mdeg = 0.0;
-    for(link = node[i]->links.begin(); link != node[i]->links.end();link++)
-      Mdeg += (*link).second;
+    LinkCursor link(node[i]->links);
+    int nb;
+    double nb_w;
+    while(link.next(nb,nb_w))
+      Mdeg += nb_w;
     node[i]->exit = Mdeg;
     node[i]->degree = Mdeg; //Update when self-links exist
   }
@@ -199,15 +376,15 @@ void Greedy::tune(void){
   }
 	
   for(int i=0;i<Nnode;i++){
-    int i_M = node[i]->index;
-    double i_d = node[i]->degree;
-    int Nlinks = node[i]->links.size(); 
+    int i_M = node_index[i];
+    double i_d = node_degree[i];
     mod_members[i_M]++;
     mod_degree[i_M] += i_d;
-    for(int j=0;j<Nlinks;j++){
-      int nb = node[i]->links[j].first;
-      double nb_w = node[i]->links[j].second;
-      int nb_M = node[nb]->index;
+    LinkCursor link(node[i]->links);
+    int nb;
+    double nb_w;
+    while(link.next(nb,nb_w)){
+      int nb_M = node_index[nb];
       if(i_M != nb_M)
 				mod_exit[i_M] += nb_w;
     }
@@ -222,6 +399,7 @@ void Greedy::tune(void){
   exit = plogp(exitDegree);
 	
   codeLength = exit - 2.0*exit_log_exit + degree_log_degree - nodeDegree_log_nodeDegree; 
+  resetDrift();
 	
 }
 
@@ -233,6 +411,11 @@ void Greedy::calibrate(void){
   vector<double>(Nmod).swap(mod_exit);
   vector<double>(Nmod).swap(mod_degree);
   vector<int>(Nmod).swap(mod_members);
+  
+  vector<int>(Nmod).swap(node_index);
+  vector<double>(Nmod).swap(node_exit);
+  vector<double>(Nmod).swap(node_degree);
+  vector<int>(Nmod).swap(node_members);
 	
   exit_log_exit = 0.0;
   degree_log_degree = 0.0;
@@ -248,11 +431,17 @@ void Greedy::calibrate(void){
     mod_degree[i] = node[i]->degree;
     mod_members[i] = node[i]->members.size();
     node[i]->index = i;
+    
+    node_index[i] = i;
+    node_exit[i] = node[i]->exit;
+    node_degree[i] = node[i]->degree;
+    node_members[i] = node[i]->members.size();
   }
 	
   exit = plogp(exitDegree);
 	
   codeLength = exit - 2.0*exit_log_exit + degree_log_degree - nodeDegree_log_nodeDegree; 
+  resetDrift();
 	
 }
 
@@ -290,6 +479,8 @@ void Greedy::prepare(bool sort){
 
 void Greedy::level(Node ***node_tmp, bool sort){
   
+  PerfRegion region(PERF_LEVEL);
+  
   prepare(sort);
   
   (*node_tmp) = new Node*[Nmod];
@@ -314,11 +505,11 @@ void Greedy::level(Node ***node_tmp, bool sort){
     
     copy(node[i]->members.begin(),node[i]->members.end(),back_inserter((*node_tmp)[i_M]->members));
 		
-    int Nlinks = node[i]->links.size(); 
-    for(int j=0;j<Nlinks;j++){
-      int nb = node[i]->links[j].first;
+    LinkCursor link(node[i]->links);
+    int nb;
+    double nb_w;
+    while(link.next(nb,nb_w)){
       int nb_M = nodeInMod[node[nb]->index];
-      double nb_w = node[i]->links[j].second;
       if (nb != i) {
 				it_M = wNtoM[i_M].find(nb_M);
 				if (it_M != wNtoM[i_M].end())
@@ -371,13 +562,14 @@ void Greedy::determMove(vector<int> &moveTo){
     double best_weight = 0.0;
 		
     if(fromM != bestM){
-      int Nlinks = node[i]->links.size();
-      
-      for(int j=0;j<Nlinks;j++){
-				if(node[node[i]->links[j].first]->index == bestM)
-					best_weight += node[i]->links[j].second;
-				else if(node[node[i]->links[j].first]->index == fromM){
-					wfromM += node[i]->links[j].second;
+      LinkCursor link(node[i]->links);
+      int nb;
+      double nb_w;
+      while(link.next(nb,nb_w)){
+				if(node_index[nb] == bestM)
+					best_weight += nb_w;
+				else if(node_index[nb] == fromM){
+					wfromM += nb_w;
 				}
       }
       
@@ -385,31 +577,15 @@ void Greedy::determMove(vector<int> &moveTo){
       if(mod_members[bestM] == 0){
 				Nempty--;
       }
-      if(mod_members[fromM] == static_cast<int>(node[i]->members.size())){
+      if(mod_members[fromM] == node_members[i]){
 				mod_empty[Nempty] = fromM;
 				Nempty++;
       }
 			
-      exitDegree -= mod_exit[fromM] + mod_exit[bestM];
-      exit_log_exit -= plogp(mod_exit[fromM]) + plogp(mod_exit[bestM]);
-      degree_log_degree -= plogp(mod_exit[fromM] + mod_degree[fromM]) + plogp(mod_exit[bestM] + mod_degree[bestM]); 
-      
-      mod_exit[fromM] -= node[i]->exit - 2*wfromM;
-      mod_degree[fromM] -= node[i]->degree;
-      mod_members[fromM] -= node[i]->members.size();
-      mod_exit[bestM] += node[i]->exit - 2*best_weight;
-      mod_degree[bestM] += node[i]->degree;
-      mod_members[bestM] += node[i]->members.size();
-			
-      exitDegree += mod_exit[fromM] + mod_exit[bestM];
-      exit_log_exit += plogp(mod_exit[fromM]) + plogp(mod_exit[bestM]);
-      degree_log_degree += plogp(mod_exit[fromM] + mod_degree[fromM]) + plogp(mod_exit[bestM] + mod_degree[bestM]); 
-      
-      exit = plogp(exitDegree);
-      
-      codeLength = exit - 2.0*exit_log_exit + degree_log_degree - nodeDegree_log_nodeDegree;
+      shift(i,fromM,bestM,wfromM,best_weight);
       
       node[i]->index = bestM;
+      node_index[i] = bestM;
 			
     }
   }
@@ -1,11 +1,13 @@
 #ifndef GREEDYBASE_H
 #define GREEDYBASE_H
-#include "MersenneTwister.h"
+#include "Random.h"
 #include <cstdio>
 #include <vector>
 using namespace std;
 // forward declaration
 class Node;
+// Order in which move() tries the modules linked to a node
+enum LinkOrder {LINKS_SHUFFLE,LINKS_ROTATE,LINKS_TIEBREAK};
 class GreedyBase{
  public:
   GreedyBase(){};
@@ -16,7 +18,14 @@ class GreedyBase{
   virtual void prepare(bool sort){};
   virtual void level(Node ***, bool sort){};
   virtual void move(bool &moved){};
+  // Try the nodes in active only, replaced by the neighbors of moved nodes
+  virtual void moveSet(vector<int> &active,bool &moved){};
   virtual void determMove(vector<int> &moveTo){};
+  // Whether rounding errors may have changed the code length enough to tune
+  virtual bool drifted(void){ return true; };
+  void setRandom(Random *RR){ R = RR; }; // Draw from another stream, e.g. one per trial
+  static LinkOrder linkOrder;
+  static bool activeSet; // Sweeps after the first try only neighbors of moved nodes
   int Nmod;
   int Nnode;
  
@@ -36,7 +45,7 @@ class GreedyBase{
  
  protected:
 
-  MTRand *R;
+  Random *R;
  
 };
 
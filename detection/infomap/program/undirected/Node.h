@@ -12,6 +12,7 @@
 #include <iomanip>
 #include <fstream>
 #include <cstring>
+#include "LinkList.h"
 class Node;
 using namespace std;
 
@@ -23,7 +24,7 @@ class Node{
   Node(int modulenr);
 
   vector<int> members; // If module, lists member nodes in module
-  vector<pair<int,double> > links; // List of identities and link weight of connected nodes/modules  
+  LinkList links; // List of identities and link weight of connected nodes/modules  
   
   double exit; // total weight of links to other nodes / modules
   double degree; // total degree of node / module
@@ -0,0 +1,32 @@
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include <iostream>
+using namespace std;
+
+// Parts of the search that are measured with hardware counters and allocation counts
+enum PerfPhase {PERF_MOVE,PERF_LEVEL,PERF_EIGENVECTOR,PERF_LOAD,PERF_COPY,PERF_SUBMODULE,PERF_HIERARCHY,PERF_SIGNIFICANCE,PERF_NPHASES};
+
+// Open the counters (Linux perf_event_open), false if they are unavailable
+bool perfEnable(void);
+bool perfEnabled(void);
+// Keep track of the current phase also without hardware counters
+void perfTrackPhases(void);
+// Innermost active phase, PERF_NPHASES outside all phases
+int perfPhase(void);
+bool perfActive(int phase);
+const char *perfPhaseName(int phase);
+void perfBegin(PerfPhase phase);
+void perfEnd(PerfPhase phase);
+void perfPrint(ostream &out);
+
+// Counts the enclosing scope as one call of a phase
+class PerfRegion{
+ public:
+  PerfRegion(PerfPhase p) : phase(p) { perfBegin(phase); }
+  ~PerfRegion(){ perfEnd(phase); }
+ private:
+  PerfPhase phase;
+};
+
+#endif
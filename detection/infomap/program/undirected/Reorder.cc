@@ -0,0 +1,104 @@
+#include "Reorder.h"
+#include <algorithm>
+#include <map>
+
+// Sort node numbers by degree, ties by number
+class degreeLess{
+ public:
+  degreeLess(vector<int> &d) : deg(d) {}
+  bool operator()(int a,int b) const { return deg[a] < deg[b] || (deg[a] == deg[b] && a < b); }
+ private:
+  vector<int> &deg;
+};
+
+class degreeGreater{
+ public:
+  degreeGreater(vector<int> &d) : deg(d) {}
+  bool operator()(int a,int b) const { return deg[a] > deg[b] || (deg[a] == deg[b] && a < b); }
+ private:
+  vector<int> &deg;
+};
+
+bool reorderKnown(string mode){
+  return mode == "degree" || mode == "rcm";
+}
+
+void reorderNodes(string mode,int Nnode,vector<int> &from,vector<int> &to,vector<int> &perm){
+
+  int Nlinks = from.size();
+  vector<int> deg(Nnode,0);
+  for(int i=0;i<Nlinks;i++){
+    deg[from[i]]++;
+    deg[to[i]]++;
+  }
+
+  vector<int> order(Nnode);
+  for(int i=0;i<Nnode;i++)
+    order[i] = i;
+
+  if(mode == "degree"){
+    sort(order.begin(),order.end(),degreeGreater(deg));
+  }
+  else{
+    // Neighbors in one array, start[i] to start[i+1] for node i
+    vector<int> start(Nnode+1,0);
+    for(int i=0;i<Nnode;i++)
+      start[i+1] = start[i] + deg[i];
+    vector<int> nb(start[Nnode]);
+    vector<int> fill(start.begin(),start.end()-1);
+    for(int i=0;i<Nlinks;i++){
+      nb[fill[from[i]]++] = to[i];
+      nb[fill[to[i]]++] = from[i];
+    }
+    for(int i=0;i<Nnode;i++)
+      sort(nb.begin()+start[i],nb.begin()+start[i+1],degreeLess(deg));
+
+    vector<int> seeds(order);
+    sort(seeds.begin(),seeds.end(),degreeLess(deg));
+    vector<bool> seen(Nnode,false);
+    int Nordered = 0;
+    for(int s=0;s<Nnode;s++){
+      if(seen[seeds[s]])
+        continue;
+      // The ordered part of order[] is the queue of the breadth-first search
+      int head = Nordered;
+      order[Nordered++] = seeds[s];
+      seen[seeds[s]] = true;
+      while(head < Nordered){
+        int v = order[head++];
+        for(int j=start[v];j<start[v+1];j++){
+          if(!seen[nb[j]]){
+            seen[nb[j]] = true;
+            order[Nordered++] = nb[j];
+          }
+        }
+      }
+    }
+    reverse(order.begin(),order.end());
+  }
+
+  perm = vector<int>(Nnode);
+  for(int i=0;i<Nnode;i++)
+    perm[order[i]] = i;
+
+}
+
+void reorderPartition(vector<int> &cluster,vector<int> &perm){
+
+  int Nnode = cluster.size();
+  vector<int> inv(Nnode);
+  for(int i=0;i<Nnode;i++)
+    inv[perm[i]] = i;
+
+  vector<int> renumbered(Nnode);
+  map<int,int> first;
+  for(int i=0;i<Nnode;i++){
+    int mod = cluster[inv[i]];
+    map<int,int>::iterator it = first.find(mod);
+    if(it == first.end())
+      it = first.insert(make_pair(mod,i)).first;
+    renumbered[i] = it->second;
+  }
+  cluster.swap(renumbered);
+
+}
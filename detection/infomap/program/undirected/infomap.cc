@@ -9,25 +9,108 @@ unsigned stou(char *s){
   return strtoul(s,(char **)NULL,10);
 }
 
-void partition(MTRand *R,Node ***node, GreedyBase *greedy, bool silent);
-void repeated_partition(MTRand *R, Node ***node, GreedyBase *greedy, bool silent,int Ntrials);
+void partition(Random *R,Node ***node, GreedyBase *greedy, bool silent, bool trial);
+void repeated_partition(Random *R, Node ***node, GreedyBase *greedy, bool silent,int Ntrials,vector<int> &initCluster);
+void incremental_partition(Node ***node, GreedyBase *greedy, vector<int> &initCluster, vector<int> &dirty);
 void printTree(string s,multimap<double,treeNode,greater<double> >::iterator it_tM,ofstream *outfile,bool flip);
 
 // Call: trade <seed> <Ntries>
 int main(int argc,char *argv[]){
   
-  if( argc !=4 ){
-    cout << "Call: ./infomap <seed> <network.net> <# attempts>" << endl;
+  // Options of the form --name follow the positional arguments
+  int Nargs = firstOption(argc,argv);
+  if( Nargs !=4 ){
+    cout << "Call: ./infomap <seed> <network.net> <# attempts> [--perf] [--alloc-stats] [--link-order shuffle|rotate|tiebreak] [--active-set] [--time-budget seconds] [--patience K] [--abandon] [--init-partition file.clu] [--warm-only] [--delta changes.txt] [--validate] [--reorder degree|rcm]" << endl;
     exit(-1);
   }
   
+  string initFile;
+  bool warmOnly = false;
+  string deltaFile;
+  bool validate = false;
+  string reorder;
+  for(int i=Nargs;i<argc;i++){
+    string option = to_string(argv[i]);
+    if(option == "--perf")
+      perfEnable();
+    else if(option == "--alloc-stats")
+      allocEnable();
+    else if(option == "--active-set")
+      GreedyBase::activeSet = true;
+    else if(option == "--link-order" && i+1 < argc){
+      string order = to_string(argv[++i]);
+      if(order == "shuffle")
+        GreedyBase::linkOrder = LINKS_SHUFFLE;
+      else if(order == "rotate")
+        GreedyBase::linkOrder = LINKS_ROTATE;
+      else if(order == "tiebreak")
+        GreedyBase::linkOrder = LINKS_TIEBREAK;
+      else{
+        cout << "Unknown link order " << order << "...exiting" << endl;
+        exit(-1);
+      }
+    }
+    else if(option == "--time-budget" && i+1 < argc){
+      double seconds = atof(argv[++i]);
+      if(seconds <= 0.0){
+        cout << "The time budget must be positive...exiting" << endl;
+        exit(-1);
+      }
+      budgetSetTime(seconds);
+    }
+    else if(option == "--abandon")
+      budgetSetAbandon();
+    else if(option == "--init-partition" && i+1 < argc)
+      initFile = string(argv[++i]);
+    else if(option == "--warm-only")
+      warmOnly = true;
+    else if(option == "--delta" && i+1 < argc)
+      deltaFile = string(argv[++i]);
+    else if(option == "--validate")
+      validate = true;
+    else if(option == "--reorder" && i+1 < argc){
+      reorder = to_string(argv[++i]);
+      if(!reorderKnown(reorder)){
+        cout << "Unknown node order " << reorder << "...exiting" << endl;
+        exit(-1);
+      }
+    }
+    else if(option == "--patience" && i+1 < argc){
+      int attempts = atoi(argv[++i]);
+      if(attempts <= 0){
+        cout << "The patience must be a positive number of attempts...exiting" << endl;
+        exit(-1);
+      }
+      budgetSetPatience(attempts);
+    }
+    else{
+      cout << "Unknown option " << option << "...exiting" << endl;
+      exit(-1);
+    }
+  }
+  
   int Ntrials = atoi(argv[3]);  // Set number of partition attempts
+  if(warmOnly){
+    if(initFile.empty()){
+      cout << "--warm-only needs --init-partition...exiting" << endl;
+      exit(-1);
+    }
+    Ntrials = 1;
+  }
+  if(!deltaFile.empty() && initFile.empty()){
+    cout << "--delta needs the partition before the changes in --init-partition...exiting" << endl;
+    exit(-1);
+  }
+  if(Ntrials == 0 && !budgetLimited()){
+    cout << "0 attempts (no limit) needs --time-budget or --patience...exiting" << endl;
+    exit(-1);
+  }
   string infile = string(argv[2]);
   string networkName(infile.begin(),infile.begin() + infile.find(".net"));
   string line;
   string buf;
   
-  MTRand *R = new MTRand(stou(argv[1]));
+  Random *R = new Random(stou(argv[1]));
   
   /* Read network in Pajek format with nodes ordered 1, 2, 3, ..., N,            */
   /* each undirected link occurring only once, and link weights > 0.             */
@@ -44,6 +127,7 @@ int main(int argc,char *argv[]){
   /* 1 3 3.3                                                                     */
   /* 2 3 2.2                                                                     */
   
+  perfBegin(PERF_LOAD);
   cout << "Reading network " << argv[2] << "..." << flush;
   ifstream net(argv[2]);
   int Nnode = 0;
@@ -146,9 +230,37 @@ int main(int argc,char *argv[]){
   
   net.close();
   
+  // End nodes of changed links
+  vector<int> dirty;
+  int Nchanges = 0;
+  if(!deltaFile.empty())
+    Nchanges = applyDelta(deltaFile,Nnode,Links,Nlinks,dirty);
+  
   cout << "done! (found " << Nnode << " nodes and " << Nlinks << " links";
   if(NdoubleLinks > 0)
     cout << ", aggregated " << NdoubleLinks << " link(s) defined more than once";
+  if(!deltaFile.empty())
+    cout << ", applied " << Nchanges << " link change(s) from " << deltaFile;
+  
+  // New number of every node in the search, the nodes are numbered back
+  // before the partition is written
+  vector<int> perm(Nnode);
+  if(reorder.empty()){
+    for(int i=0;i<Nnode;i++)
+      perm[i] = i;
+  }
+  else{
+    vector<int> from,to;
+    for(map<int,map<int,double> >::iterator fromLink_it = Links.begin(); fromLink_it != Links.end(); fromLink_it++)
+      for(map<int,double>::iterator toLink_it = fromLink_it->second.begin(); toLink_it != fromLink_it->second.end(); toLink_it++)
+        if(toLink_it->second > 0.0 && fromLink_it->first != toLink_it->first){
+          from.push_back(fromLink_it->first);
+          to.push_back(toLink_it->first);
+        }
+    reorderNodes(reorder,Nnode,from,to,perm);
+    for(int i=0;i<int(dirty.size());i++)
+      dirty[i] = perm[dirty[i]];
+  }
   
   /////////// Partition network /////////////////////
   double totalDegree = 0.0;
@@ -171,8 +283,8 @@ int main(int argc,char *argv[]){
           NselfLinks++;
         }
         else{
-          node[from]->links.push_back(make_pair(to,weight));
-          node[to]->links.push_back(make_pair(from,weight));
+          node[perm[from]]->links.push_back(make_pair(perm[to],weight));
+          node[perm[to]]->links.push_back(make_pair(perm[from],weight));
           totalDegree += 2*weight;
           degree[from] += weight;
           degree[to] += weight;
@@ -185,10 +297,13 @@ int main(int argc,char *argv[]){
   else
     cout << ")" << endl;
   
-  //Swap maps to free memory
-  for(map<int,map<int,double> >::iterator it = Links.begin(); it != Links.end(); it++)
-    map<int,double>().swap(it->second);
-  map<int,map<int,double> >().swap(Links);
+  //Swap maps to free memory, unless they are needed to check the code length
+  if(!validate){
+    for(map<int,map<int,double> >::iterator it = Links.begin(); it != Links.end(); it++)
+      map<int,double>().swap(it->second);
+    map<int,map<int,double> >().swap(Links);
+  }
+  perfEnd(PERF_LOAD);
   
   // Initiation
   GreedyBase* greedy;
@@ -197,11 +312,51 @@ int main(int argc,char *argv[]){
   
   double uncompressedCodeLength = -greedy->nodeDegree_log_nodeDegree;
 
-  cout << "Now partition the network:" << endl;
-  repeated_partition(R,&node,greedy,false,Ntrials);
+  vector<int> initCluster;
+  if(!initFile.empty()){
+    loadPartition(initFile,Nnode,initCluster);
+    if(!reorder.empty())
+      reorderPartition(initCluster,perm);
+  }
+  
+  if(!deltaFile.empty()){
+    cout << "Now update the partition of the network:" << endl;
+    incremental_partition(&node,greedy,initCluster,dirty);
+  }
+  else{
+    cout << "Now partition the network:" << endl;
+    repeated_partition(R,&node,greedy,false,Ntrials,initCluster);
+  }
   int Nmod = greedy->Nnode;
+  if(!reorder.empty()){
+    vector<int> inv(Nnode);
+    for(int i=0;i<Nnode;i++)
+      inv[perm[i]] = i;
+    for(int i=0;i<Nmod;i++){
+      int Nmembers = node[i]->members.size();
+      for(int j=0;j<Nmembers;j++)
+        node[i]->members[j] = inv[node[i]->members[j]];
+    }
+  }
   cout << "Done! Code length " << greedy->codeLength << " in " << Nmod << " modules." << endl;
   cout << "Compressed by " << 100.0*(1.0-greedy->codeLength/uncompressedCodeLength) << " percent." << endl;
+  if(validate){
+    vector<int> cluster(Nnode);
+    for(int i=0;i<Nmod;i++){
+      int Nmembers = node[i]->members.size();
+      for(int j=0;j<Nmembers;j++)
+        cluster[node[i]->members[j]] = i;
+    }
+    double checkCodeLength = mapEquation(Links,Nnode,cluster);
+    double diff = fabs(checkCodeLength - greedy->codeLength);
+    cout << "Code length in double precision " << checkCodeLength << ", difference " << diff << "." << endl;
+    if(diff > 1.0e-6*checkCodeLength){
+      cout << "The code length differs by more than the tolerance of 1e-6 relative...exiting" << endl;
+      exit(-1);
+    }
+  }
+  perfPrint(cout);
+  allocPrint(cout);
   
   // Order modules by size
   multimap<double,treeNode,greater<double> > treeMap;
@@ -219,10 +374,12 @@ int main(int argc,char *argv[]){
   // Order links by size
   multimap<double,pair<int,int>,greater<double> > sortedLinks;
   for(int i=0;i<Nmod;i++){
-    int Nlinks = node[i]->links.size();
-    for(int j=0;j<Nlinks;j++){
-      if(i <= node[i]->links[j].first)
-        sortedLinks.insert(make_pair(node[i]->links[j].second/totalDegree,make_pair(i+1,node[i]->links[j].first+1)));
+    LinkCursor link(node[i]->links);
+    int nb;
+    double nb_w;
+    while(link.next(nb,nb_w)){
+      if(i <= nb)
+        sortedLinks.insert(make_pair(nb_w/totalDegree,make_pair(i+1,nb+1)));
     }
   }
   
@@ -320,31 +477,38 @@ int main(int argc,char *argv[]){
   
 }
 
-void partition(MTRand *R,Node ***node, GreedyBase *greedy, bool silent){
+void partition(Random *R,Node ***node, GreedyBase *greedy, bool silent, bool trial){
   
   int Nnode = greedy->Nnode;
+  perfBegin(PERF_COPY);
   Node **cpy_node = new Node*[Nnode];
   for(int i=0;i<Nnode;i++){
     cpy_node[i] = new Node();
     cpyNode(cpy_node[i],(*node)[i]);
   }
+  perfEnd(PERF_COPY);
   
   int iteration = 0;
+  double firstCodeLength = 0.0;
+  bool abandoned = false;
   double outer_oldCodeLength;
   do{
     outer_oldCodeLength = greedy->codeLength;
     
     if((iteration > 0) && (iteration % 2 == 0) && (greedy->Nnode > 1)){  // Partition the partition
       
+      PerfRegion region(PERF_SUBMODULE);
       
       if(!silent)
         cout << "Iteration " << iteration+1 << ", moving " << flush;
       
+      perfBegin(PERF_COPY);
       Node **rpt_node = new Node*[Nnode];
       for(int i=0;i<Nnode;i++){
         rpt_node[i] = new Node();
         cpyNode(rpt_node[i],cpy_node[i]);
       }
+      perfEnd(PERF_COPY);
       vector<int> subMoveTo(Nnode);
       vector<int> moveTo(Nnode);
       int subModIndex = 0;
@@ -356,40 +520,15 @@ void partition(MTRand *R,Node ***node, GreedyBase *greedy, bool silent){
         if(sub_Nnode > 1){
           
           Node **sub_node = new Node*[sub_Nnode]; 
-          set<int> sub_mem;
-          for(int j=0;j<sub_Nnode;j++)
-            sub_mem.insert((*node)[i]->members[j]);
-          set<int>::iterator it_mem = sub_mem.begin();
-          int *sub_renumber = new int[Nnode];
-          int *sub_rev_renumber = new int[sub_Nnode];
-          double totalDegree = 0.0;
-          for(int j=0;j<sub_Nnode;j++){
-            
-            //    fprintf(stderr,"%d %d\n",j,(*it_mem));
-            int orig_nr = (*it_mem);
-            int orig_Nlinks = cpy_node[orig_nr]->links.size(); // ERROR HERE
-            sub_renumber[orig_nr] = j;
-            sub_rev_renumber[j] = orig_nr;
-            sub_node[j] = new Node(j);
-            for(int k=0;k<orig_Nlinks;k++){
-              int orig_link = cpy_node[orig_nr]->links[k].first;
-              int orig_link_newnr = sub_renumber[orig_link];
-              double orig_weight = cpy_node[orig_nr]->links[k].second;
-              if(orig_link < orig_nr){
-                if(sub_mem.find(orig_link) != sub_mem.end()){
-                  sub_node[j]->links.push_back(make_pair(orig_link_newnr,orig_weight));
-                  sub_node[orig_link_newnr]->links.push_back(make_pair(j,orig_weight));
-                  totalDegree += 2.0*orig_weight;
-                }
-              }
-            }
-            it_mem++;
-          }
+          vector<int> sub_rev_renumber((*node)[i]->members);
+          sort(sub_rev_renumber.begin(),sub_rev_renumber.end());
+          double totalDegree = extractSubNet(cpy_node,Nnode,sub_rev_renumber,sub_node);
           
+          Random sub_R = R->split(); // Own stream for each submodule
           GreedyBase* sub_greedy;
-          sub_greedy = new Greedy(R,sub_Nnode,totalDegree,sub_node);
+          sub_greedy = new Greedy(&sub_R,sub_Nnode,totalDegree,sub_node);
           sub_greedy->initiate();
-          partition(R,&sub_node,sub_greedy,true);
+          partition(&sub_R,&sub_node,sub_greedy,true,false);
           for(int j=0;j<sub_greedy->Nnode;j++){
             int Nmembers = sub_node[j]->members.size();
             for(int k=0;k<Nmembers;k++){
@@ -402,8 +541,6 @@ void partition(MTRand *R,Node ***node, GreedyBase *greedy, bool silent){
           
           delete [] sub_node;
           delete sub_greedy;
-          delete [] sub_renumber;
-          delete [] sub_rev_renumber;
           
         }
         else{
@@ -441,11 +578,13 @@ void partition(MTRand *R,Node ***node, GreedyBase *greedy, bool silent){
         cout << "Iteration " << iteration+1 << ", moving " << Nnode << " nodes, looping " << flush;
       
       
+      perfBegin(PERF_COPY);
       Node **rpt_node = new Node*[Nnode];
       for(int i=0;i<Nnode;i++){
         rpt_node[i] = new Node();
         cpyNode(rpt_node[i],cpy_node[i]);
       }
+      perfEnd(PERF_COPY);
       
       vector<int> moveTo(Nnode);
       for(int i=0;i<greedy->Nnode;i++){
@@ -479,20 +618,26 @@ void partition(MTRand *R,Node ***node, GreedyBase *greedy, bool silent){
       oldCodeLength = greedy->codeLength;
       bool moved = true;
       int Nloops = 0;
-      int count = 0;
+      vector<int> active; // Nodes to try in the next sweep
+      if(GreedyBase::activeSet){
+        active.resize(greedy->Nnode);
+        for(int i=0;i<greedy->Nnode;i++)
+          active[i] = i;
+      }
       while(moved){
         moved = false;
         double inner_oldCodeLength = greedy->codeLength;
-        greedy->move(moved);
+        if(GreedyBase::activeSet)
+          greedy->moveSet(active,moved);
+        else
+          greedy->move(moved);
         Nloops++;
-        count++;
-        if(fabs(inner_oldCodeLength-greedy->codeLength) < 1.0e-10)
+        if(fabs(inner_oldCodeLength-greedy->codeLength) < 1.0e-10 || budgetSpent() || (GreedyBase::activeSet && active.empty()))
           moved = false;
         
-        if(count == 10){	  
+        // Recompute the code length only when rounding may have changed it
+        if(greedy->drifted())
           greedy->tune();
-          count = 0;
-        }
         // 	if(!silent){
         // 	  cerr << Nloops;
         // 	  int loopsize = to_string(Nloops).length();
@@ -506,13 +651,26 @@ void partition(MTRand *R,Node ***node, GreedyBase *greedy, bool silent){
       if(!silent)
         cout << Nloops << " " << flush;
       
-    } while(oldCodeLength - greedy->codeLength >  1.0e-10);
+    } while(oldCodeLength - greedy->codeLength >  1.0e-10 && !budgetSpent());
     
     iteration++;
     if(!silent)
       cout << "times between mergings to code length " <<  greedy->codeLength << " in " << greedy->Nmod << " modules." << endl;
     
-  } while(outer_oldCodeLength - greedy->codeLength > 1.0e-10);
+    // Give up attempts that cannot be expected to beat the best one
+    if(trial && iteration == 1){
+      firstCodeLength = greedy->codeLength;
+      if(budgetHopeless(firstCodeLength)){
+        if(!silent)
+          cout << "Abandoning the attempt, it is not expected to beat the best code length." << endl;
+        abandoned = true;
+        break;
+      }
+    }
+    
+  } while(outer_oldCodeLength - greedy->codeLength > 1.0e-10 && !budgetSpent());
+  if(trial && !abandoned)
+    budgetRecordTrial(firstCodeLength,greedy->codeLength);
   
   for(int i=0;i<Nnode;i++)
     delete cpy_node[i];
@@ -520,33 +678,46 @@ void partition(MTRand *R,Node ***node, GreedyBase *greedy, bool silent){
   
 }
 
-void repeated_partition(MTRand *R, Node ***node, GreedyBase *greedy, bool silent,int Ntrials){
+void repeated_partition(Random *R, Node ***node, GreedyBase *greedy, bool silent,int Ntrials,vector<int> &initCluster){
   
   double shortestCodeLength = 1000.0;
   int Nnode = greedy->Nnode;
   vector<int> cluster(Nnode);
   
-  for(int trial = 0; trial<Ntrials;trial++){
+  int Nstale = 0; // Attempts since the last improvement
+  for(int trial = 0; budgetNextTrial(trial,Ntrials,Nstale,silent); trial++){
     
     if(!silent)
-      cout << "Attempt " << trial+1 << "/" << Ntrials << endl;
+      cout << "Attempt " << trial+1 << (Ntrials > 0 ? "/" + to_string(Ntrials) : string("")) << endl;
     
+    perfBegin(PERF_COPY);
     Node **cpy_node = new Node*[Nnode];
     for(int i=0;i<Nnode;i++){
       cpy_node[i] = new Node();
       cpyNode(cpy_node[i],(*node)[i]);
     }
+    perfEnd(PERF_COPY);
     
     greedy->Nnode = Nnode;
     greedy->Nmod = Nnode;
     greedy->node = cpy_node;
     greedy->initiate();
+    // The first attempt starts from the initial partition, if any
+    if(trial == 0 && !initCluster.empty())
+      greedy->determMove(initCluster);
     
-    partition(R,&cpy_node,greedy,silent);
+    Random trial_R = R->split(trial); // Own stream for each trial
+    greedy->setRandom(&trial_R);
+    partition(&trial_R,&cpy_node,greedy,silent,true);
     
+    if(greedy->codeLength < shortestCodeLength - 1.0e-10)
+      Nstale = 0;
+    else
+      Nstale++;
     if(greedy->codeLength < shortestCodeLength){
       
       shortestCodeLength = greedy->codeLength;
+      budgetOffer(shortestCodeLength);
       
       // Store best partition
       for(int i=0;i<greedy->Nnode;i++){
@@ -563,6 +734,8 @@ void repeated_partition(MTRand *R, Node ***node, GreedyBase *greedy, bool silent
     
   }
   
+  greedy->setRandom(R);
+  
   // Commit best partition
   greedy->Nnode = Nnode;
   greedy->Nmod = Nnode;
@@ -573,6 +746,57 @@ void repeated_partition(MTRand *R, Node ***node, GreedyBase *greedy, bool silent
   
 }
 
+void incremental_partition(Node ***node, GreedyBase *greedy, vector<int> &initCluster, vector<int> &dirty){
+  
+  int Nnode = greedy->Nnode;
+  greedy->determMove(initCluster);
+  cout << "Partition before the changes has code length " << greedy->codeLength << "." << endl;
+  
+  // Move only the end nodes of changed links, and then the neighbors of
+  // nodes that changed module
+  vector<char> touched(Nnode,0);
+  vector<int> active = dirty;
+  int Nevaluated = 0;
+  cout << "Moving nodes next to changed links, active nodes per sweep: ";
+  double oldCodeLength;
+  do{
+    oldCodeLength = greedy->codeLength;
+    int Nactive = active.size();
+    for(int i=0;i<Nactive;i++)
+      touched[active[i]] = 1;
+    Nevaluated += Nactive;
+    cout << Nactive << " " << flush;
+    bool moved = false;
+    greedy->moveSet(active,moved);
+  } while(!active.empty() && oldCodeLength - greedy->codeLength > 1.0e-10 && !budgetSpent());
+  cout << endl << Nevaluated << " node evaluations to code length " << greedy->codeLength << "." << endl;
+  
+  // Refresh the coarse level once: only modules with moved or changed
+  // nodes may merge
+  if(greedy->drifted())
+    greedy->tune();
+  greedy->level(node,false);
+  vector<int> activeMod;
+  for(int i=0;i<greedy->Nnode;i++){
+    int Nmembers = (*node)[i]->members.size();
+    for(int j=0;j<Nmembers;j++)
+      if(touched[(*node)[i]->members[j]]){
+        activeMod.push_back(i);
+        break;
+      }
+  }
+  cout << "Moving " << activeMod.size() << " of " << greedy->Nnode << " modules, active modules per sweep: ";
+  do{
+    oldCodeLength = greedy->codeLength;
+    cout << activeMod.size() << " " << flush;
+    bool moved = false;
+    greedy->moveSet(activeMod,moved);
+  } while(!activeMod.empty() && oldCodeLength - greedy->codeLength > 1.0e-10 && !budgetSpent());
+  cout << endl;
+  greedy->level(node,true);
+  
+}
+
 void printTree(string s,multimap<double,treeNode,greater<double> >::iterator it_tM,ofstream *outfile,bool flip){
   
   multimap<double,treeNode,greater<double> >::iterator it;
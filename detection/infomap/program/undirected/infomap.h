@@ -7,10 +7,15 @@
 #include <sstream>
 #include <fstream>
 #include <iomanip>
-#include "MersenneTwister.h"
+#include "Random.h"
 #include "GreedyBase.h" 
 #include "Greedy.h" 
 #include "Node.h" 
+#include "PerfCounters.h"
+#include "AllocTracker.h"
+#include "Budget.h"
+#include "Reorder.h"
+#include "SubNet.h"
 #define PI 3.14159265
 using namespace std;
 
@@ -29,6 +34,197 @@ inline std::string to_string (const T& t){
   return ss.str();
 }
 
+// Index of the first --option argument, or argc if there are none
+int firstOption(int argc,char *argv[]){
+  for(int i=1;i<argc;i++)
+    if(strncmp(argv[i],"--",2) == 0)
+      return i;
+  return argc;
+}
+
+// Read a partition in Pajek's .clu format, as written by the programs, and
+// number every module by its first node. Moving each node to the module of
+// its first member never fills a module that has been emptied, as determMove
+// expects.
+void loadPartition(string file,int Nnode,vector<int> &cluster){
+  
+  cout << "Reading initial partition " << file << "..." << flush;
+  ifstream clu(file.c_str());
+  if(!clu){
+    cout << "cannot open the file...exiting" << endl;
+    exit(-1);
+  }
+  string line;
+  string buf;
+  istringstream ss;
+  int Nclu = -1;
+  while(Nclu < 0 && getline(clu,line)){
+    ss.clear();
+    ss.str(line);
+    buf = "";
+    ss >> buf;
+    if(buf == "*Vertices" || buf == "*vertices" || buf == "*VERTICES")
+      ss >> Nclu;
+  }
+  if(Nclu != Nnode){
+    cout << "the partition has " << Nclu << " nodes, the network " << Nnode << "...exiting" << endl;
+    exit(-1);
+  }
+  
+  cluster = vector<int>(Nnode);
+  map<int,int> first;
+  for(int i=0;i<Nnode;i++){
+    int mod;
+    if(!(clu >> mod)){
+      cout << "the partition ends after " << i << " nodes...exiting" << endl;
+      exit(-1);
+    }
+    map<int,int>::iterator it = first.find(mod);
+    if(it == first.end())
+      it = first.insert(make_pair(mod,i)).first;
+    cluster[i] = it->second;
+  }
+  cout << "done! (" << first.size() << " modules)" << endl;
+  
+}
+
+// Apply a file of link changes to the links read from the network, one change
+// per line with nodes numbered from 1 as in the network file:
+//   + from to [weight]  add weight to the link, 1 by default
+//   - from to           remove the link
+//   = from to weight    set the weight of the link, removed if not positive
+// The end nodes of changed links are returned in dirty, each once, and the
+// number of changes is returned.
+int applyDelta(string file,int Nnode,map<int,map<int,double> > &Links,int &Nlinks,vector<int> &dirty){
+  
+  ifstream delta(file.c_str());
+  if(!delta){
+    cout << endl << "Cannot open link changes " << file << "...exiting" << endl;
+    exit(-1);
+  }
+  string line;
+  string op;
+  string buf;
+  istringstream ss;
+  vector<char> isDirty(Nnode,0);
+  int Nchanges = 0;
+  while(getline(delta,line)){
+    ss.clear();
+    ss.str(line);
+    op = "";
+    int linkEnd1 = 0;
+    int linkEnd2 = 0;
+    double linkWeight = 1.0;
+    ss >> op;
+    if(op.empty() || op[0] == '#')
+      continue;
+    ss >> linkEnd1 >> linkEnd2;
+    buf.clear();
+    ss >> buf;
+    if(!buf.empty()) // The weight is optional
+      linkWeight = atof(buf.c_str());
+    if((op != "+" && op != "-" && op != "=") || linkEnd1 < 1 || linkEnd1 > Nnode || linkEnd2 < 1 || linkEnd2 > Nnode){
+      cout << endl << "Cannot read link change \"" << line << "\" in " << file << "...exiting" << endl;
+      exit(-1);
+    }
+    
+    linkEnd1--; // Nodes start at 1, but C++ arrays at 0.
+    linkEnd2--;
+    if(linkEnd2 < linkEnd1){
+      int tmp = linkEnd1;
+      linkEnd1 = linkEnd2;
+      linkEnd2 = tmp;
+    }
+    
+    map<int,double> &toLinks = Links[linkEnd1];
+    map<int,double>::iterator toLink_it = toLinks.find(linkEnd2);
+    bool exists = (toLink_it != toLinks.end());
+    double weight = exists ? toLink_it->second : 0.0;
+    if(op == "+")
+      weight += linkWeight;
+    else if(op == "-")
+      weight = 0.0;
+    else
+      weight = linkWeight;
+    
+    if(weight > 0.0){
+      if(!exists)
+        Nlinks++;
+      toLinks[linkEnd2] = weight;
+    }
+    else if(exists){
+      toLinks.erase(toLink_it);
+      Nlinks--;
+    }
+    else
+      continue; // Removing a link that does not exist changes nothing
+    
+    Nchanges++;
+    for(int k=0;k<2;k++){
+      int end = (k == 0 ? linkEnd1 : linkEnd2);
+      if(!isDirty[end]){
+        isDirty[end] = 1;
+        dirty.push_back(end);
+      }
+    }
+  }
+  
+  return Nchanges;
+  
+}
+
+double plogp(double p){
+  return p > 0.0 ? p*log(p) : 0.0;
+}
+
+// Code length of a partition computed directly from the links in double
+// precision, to check the code length found with compact link storage
+double mapEquation(map<int,map<int,double> > &Links,int Nnode,vector<int> &cluster){
+  
+  int Nmod = 0;
+  for(int i=0;i<Nnode;i++)
+    if(cluster[i] >= Nmod)
+      Nmod = cluster[i] + 1;
+  
+  double totalDegree = 0.0;
+  vector<double> degree(Nnode,0.0);
+  vector<double> modExit(Nmod,0.0);
+  vector<double> modDegree(Nmod,0.0);
+  for(map<int,map<int,double> >::iterator fromLink_it = Links.begin(); fromLink_it != Links.end(); fromLink_it++){
+    for(map<int,double>::iterator toLink_it = fromLink_it->second.begin(); toLink_it != fromLink_it->second.end(); toLink_it++){
+      int from = fromLink_it->first;
+      int to = toLink_it->first;
+      double weight = toLink_it->second;
+      if(weight > 0.0 && from != to){
+        degree[from] += weight;
+        degree[to] += weight;
+        totalDegree += 2*weight;
+        if(cluster[from] != cluster[to]){
+          modExit[cluster[from]] += weight;
+          modExit[cluster[to]] += weight;
+        }
+      }
+    }
+  }
+  for(int i=0;i<Nnode;i++)
+    modDegree[cluster[i]] += degree[i];
+  
+  double exitDegree = 0.0;
+  double exit_log_exit = 0.0;
+  double degree_log_degree = 0.0;
+  double nodeDegree_log_nodeDegree = 0.0;
+  for(int i=0;i<Nmod;i++){
+    exitDegree += modExit[i];
+    exit_log_exit += plogp(modExit[i]/totalDegree);
+    degree_log_degree += plogp((modExit[i] + modDegree[i])/totalDegree);
+  }
+  for(int i=0;i<Nnode;i++)
+    nodeDegree_log_nodeDegree += plogp(degree[i]/totalDegree);
+  
+  return (plogp(exitDegree/totalDegree) - 2.0*exit_log_exit + degree_log_degree - nodeDegree_log_nodeDegree)/log(2.0);
+  
+}
+
 
 void cpyNode(Node *newNode,Node *oldNode){
   
@@ -41,12 +237,7 @@ void cpyNode(Node *newNode,Node *oldNode){
   for(int i=0;i<Nmembers;i++)
     newNode->members[i] = oldNode->members[i];
   
-  int Nlinks = oldNode->links.size();
-  newNode->links = vector<pair<int,double> >(Nlinks);
-  for(int i=0;i<Nlinks;i++){
-    newNode->links[i].first = oldNode->links[i].first;
-    newNode->links[i].second = oldNode->links[i].second;
-  }
+  newNode->links = oldNode->links;
 
 }
 
@@ -1,4 +1,5 @@
 #include "Greedy.h"
+#include "PerfCounters.h"
 
 Greedy::~Greedy(){  
   
@@ -7,7 +8,7 @@ Greedy::~Greedy(){
   
 }
 
-Greedy::Greedy(MTRand *RR,int nnode,int nlinks,Node **ah){
+Greedy::Greedy(Random *RR,int nnode,int nlinks,Node **ah){
 
   R = RR;
   Nnode = nnode;  
@@ -20,18 +21,15 @@ Greedy::Greedy(MTRand *RR,int nnode,int nlinks,Node **ah){
 
 void Greedy::move(bool &moved){
   
+  PerfRegion region(PERF_MOVE);
+  
   if(Nnode > 1){
     
     //   Generate random enumeration of nodes
     vector<int> randomOrder(Nnode);
     for(int i=0;i<Nnode;i++)
       randomOrder[i] = i;
-    for(int i=0;i<Nnode-1;i++){
-      int randPos = i + R->randInt(Nnode-i-1);
-      int tmp = randomOrder[i];
-      randomOrder[i] = randomOrder[randPos];
-      randomOrder[randPos] = tmp;
-    }
+    R->shuffle(&randomOrder[0],Nnode);
     
   
 
@@ -432,6 +430,8 @@ void Greedy::prepare(bool sort){
 
 void Greedy::level(Node ***node_tmp, bool sort){
   
+  PerfRegion region(PERF_LEVEL);
+  
   prepare(sort);
   
   (*node_tmp) = new Node*[Nmod];
@@ -1,10 +1,11 @@
 #ifndef GREEDY_H
 #define GREEDY_H
 
-#include "MersenneTwister.h"
+#include "Random.h"
 #include "GreedyBase.h"
 #include "Node.h"
 #include <cmath>
+#include <climits>
 #include <iostream>
 #include <vector>
 #include <queue>
@@ -18,7 +19,7 @@ using namespace std;
 
 class Greedy : public GreedyBase{
  public:
-  Greedy(MTRand *RR,int nnode,int deg,Node **node);
+  Greedy(Random *RR,int nnode,int deg,Node **node);
   virtual ~Greedy();
   virtual void initiate(void);
   virtual void calibrate(void);
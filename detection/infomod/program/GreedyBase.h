@@ -1,6 +1,6 @@
 #ifndef GREEDYBASE_H
 #define GREEDYBASE_H
-#include "MersenneTwister.h"
+#include "Random.h"
 #include <cstdio>
 #include <vector>
 using namespace std;
@@ -17,6 +17,7 @@ class GreedyBase{
   virtual void move(bool &moved){};
   virtual void determMove(int *moveTo){};
   virtual void genLogTable(int maxsize){};  
+  void setRandom(Random *RR){ R = RR; }; // Draw from another stream, e.g. one per trial
   int Nmod;
   int Nnode;
   int Nmem;
@@ -35,7 +36,7 @@ class GreedyBase{
   
  protected:
   
-  MTRand *R;
+  Random *R;
   
 };
 
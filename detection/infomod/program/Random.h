@@ -0,0 +1,147 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+// Counter-based random number streams (Philox4x32-10, Salmon et al. SC'11).
+// The numbers of a stream only depend on its key and position, and split()
+// derives the key of an independent stream from the key of the parent and a
+// task number. Each trial, bootstrap, submodule and subtree draws from a stream
+// given by (seed, task path), so results do not depend on the order in which
+// the tasks are run. split() without a task number takes the next number in
+// the sequence of the parent, for subtasks created one after another.
+// Numbers are generated RANDOM_BATCH at a time in one tight loop over
+// consecutive counters, and bounded integers use a multiplication instead of
+// a division or a rejection loop over bit masks.
+
+#include <algorithm>
+
+#define RANDOM_BATCH 64
+
+class Random{
+ public:
+  Random(unsigned long seed);
+  Random split(unsigned long task) const;
+  Random split();
+
+  unsigned long randInt();                // integer in [0,2^32-1]
+  unsigned long randInt(unsigned long n); // integer in [0,n]
+  unsigned long randBelow(unsigned long n); // integer in [0,n-1], n <= 2^32
+  double rand();                          // real number in [0,1]
+  double randExc();                       // real number in [0,1)
+  template<class T> void shuffle(T *a,int n); // uniform random permutation
+
+ private:
+  Random(unsigned long long k,bool);
+  void generate();
+  static unsigned long long mix(unsigned long long z);
+
+  unsigned long long key;
+  unsigned long long counter;
+  unsigned long Nsplits;
+  unsigned int block[RANDOM_BATCH];
+  int Nleft;
+};
+
+inline unsigned long long Random::mix(unsigned long long z){
+  // SplitMix64 finalizer
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+inline Random::Random(unsigned long seed){
+  key = mix(seed + 0x9e3779b97f4a7c15ULL);
+  counter = 0;
+  Nsplits = 0;
+  Nleft = 0;
+}
+
+inline Random::Random(unsigned long long k,bool){
+  key = k;
+  counter = 0;
+  Nsplits = 0;
+  Nleft = 0;
+}
+
+// Even task numbers for explicit tasks, odd for sequential ones
+inline Random Random::split(unsigned long task) const{
+  return Random(mix(key ^ mix(2ULL*task + 0x9e3779b97f4a7c15ULL)),true);
+}
+
+inline Random Random::split(){
+  return Random(mix(key ^ mix(2ULL*(Nsplits++) + 1ULL + 0x9e3779b97f4a7c15ULL)),true);
+}
+
+inline void Random::generate(){
+
+  unsigned int k0 = static_cast<unsigned int>(key);
+  unsigned int k1 = static_cast<unsigned int>(key >> 32);
+  for(int b=0;b<RANDOM_BATCH;b+=4){
+    unsigned int c0 = static_cast<unsigned int>(counter);
+    unsigned int c1 = static_cast<unsigned int>(counter >> 32);
+    unsigned int c2 = 0;
+    unsigned int c3 = 0;
+    unsigned int r0 = k0;
+    unsigned int r1 = k1;
+    for(int round=0;round<10;round++){
+      unsigned long long p0 = 0xD2511F53ULL*c0;
+      unsigned long long p1 = 0xCD9E8D57ULL*c2;
+      unsigned int n0 = static_cast<unsigned int>(p1 >> 32) ^ c1 ^ r0;
+      unsigned int n2 = static_cast<unsigned int>(p0 >> 32) ^ c3 ^ r1;
+      c1 = static_cast<unsigned int>(p1);
+      c3 = static_cast<unsigned int>(p0);
+      c0 = n0;
+      c2 = n2;
+      r0 += 0x9E3779B9U;
+      r1 += 0xBB67AE85U;
+    }
+    block[b] = c0;
+    block[b+1] = c1;
+    block[b+2] = c2;
+    block[b+3] = c3;
+    counter++;
+  }
+  Nleft = RANDOM_BATCH;
+
+}
+
+inline unsigned long Random::randInt(){
+  if(Nleft == 0)
+    generate();
+  return block[--Nleft];
+}
+
+inline unsigned long Random::randInt(unsigned long n){
+  if(n >= 0xFFFFFFFFUL)
+    return randInt();
+  return randBelow(n+1);
+}
+
+inline unsigned long Random::randBelow(unsigned long n){
+  // Lemire's multiply-shift, rejecting the few products that would bias the result
+  unsigned long long m = static_cast<unsigned long long>(randInt())*n;
+  unsigned int low = static_cast<unsigned int>(m);
+  if(low < n){
+    unsigned int threshold = static_cast<unsigned int>((0x100000000ULL - n) % n);
+    while(low < threshold){
+      m = static_cast<unsigned long long>(randInt())*n;
+      low = static_cast<unsigned int>(m);
+    }
+  }
+  return static_cast<unsigned long>(m >> 32);
+}
+
+inline double Random::rand(){
+  return double(randInt()) * (1.0/4294967295.0);
+}
+
+inline double Random::randExc(){
+  return double(randInt()) * (1.0/4294967296.0);
+}
+
+template<class T> inline void Random::shuffle(T *a,int n){
+  // Fisher-Yates from the back
+  for(int i=n-1;i>0;i--)
+    std::swap(a[i],a[randBelow(i+1)]);
+}
+
+#endif
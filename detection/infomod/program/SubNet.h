@@ -0,0 +1,18 @@
+#ifndef SUBNET_H
+#define SUBNET_H
+
+#include <vector>
+#include "Node.h"
+using namespace std;
+
+// Subnetwork induced by members, original node numbers below Nnode in
+// increasing order: member j becomes sub_node[j] with the links among the
+// members in the order of the original links. Returns the weight of the
+// links among the members, counted once.
+// The local number of every member is kept in one dense array over the
+// original nodes, tagged with the number of the extraction, so an extraction
+// clears nothing and finds a member with one lookup. The array is shared, so
+// extractions must not run concurrently.
+int extractSubNet(Node **orig_node,int Nnode,vector<int> &members,Node **sub_node);
+
+#endif
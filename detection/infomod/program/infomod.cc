@@ -9,25 +9,61 @@ unsigned stou(char *s){
   return strtoul(s,(char **)NULL,10);
 }
 
-void partition(MTRand *R,Node ***node, GreedyBase *greedy, bool silent);
-void repeated_partition(MTRand *R, Node ***node, GreedyBase *greedy, bool silent,int Ntrials);
+void partition(Random *R,Node ***node, GreedyBase *greedy, bool silent, bool trial);
+void repeated_partition(Random *R, Node ***node, GreedyBase *greedy, bool silent,int Ntrials);
 void printTree(string s,multimap<int,treeNode>::reverse_iterator it_tM,string *nodeNames,int *degree,int totalDegree,ofstream *outfile);
 
 // Call: trade <seed> <Ntries>
 int main(int argc,char *argv[]){
   
-  if( argc !=4 ){
-    cout << "Call: ./infomap <seed> <network.net> <# attempts>" << endl;
+  // Options of the form --name follow the positional arguments
+  int Nargs = firstOption(argc,argv);
+  if( Nargs !=4 ){
+    cout << "Call: ./infomap <seed> <network.net> <# attempts> [--perf] [--alloc-stats] [--time-budget seconds] [--patience K] [--abandon]" << endl;
     exit(-1);
   }
+  
+  for(int i=Nargs;i<argc;i++){
+    string option = to_string(argv[i]);
+    if(option == "--perf")
+      perfEnable();
+    else if(option == "--alloc-stats")
+      allocEnable();
+    else if(option == "--time-budget" && i+1 < argc){
+      double seconds = atof(argv[++i]);
+      if(seconds <= 0.0){
+        cout << "The time budget must be positive...exiting" << endl;
+        exit(-1);
+      }
+      budgetSetTime(seconds);
+    }
+    else if(option == "--abandon")
+      budgetSetAbandon();
+    else if(option == "--patience" && i+1 < argc){
+      int attempts = atoi(argv[++i]);
+      if(attempts <= 0){
+        cout << "The patience must be a positive number of attempts...exiting" << endl;
+        exit(-1);
+      }
+      budgetSetPatience(attempts);
+    }
+    else{
+      cout << "Unknown option " << option << "...exiting" << endl;
+      exit(-1);
+    }
+  }
 
   int Ntrials = atoi(argv[3]);  // Set number of partition attempts
+  if(Ntrials == 0 && !budgetLimited()){
+    cout << "0 attempts (no limit) needs --time-budget or --patience...exiting" << endl;
+    exit(-1);
+  }
   string infile = string(argv[2]);
   string networkName(infile.begin(),infile.begin() + infile.find(".net")); //TODO only modif: added net in ".net" because the dot can appear elsewhere (like in infomap)
   string line;
   string buf;
 
-  MTRand *R = new MTRand(stou(argv[1]));
+  Random *R = new Random(stou(argv[1]));
 
   /* Read network in Pajek format with nodes ordered 1, 2, 3, ..., N,            */
   /* each undirected link occurring only once, and integer link weights > 0.     */
@@ -43,6 +79,7 @@ int main(int argc,char *argv[]){
   /* 1 3 3                                                                       */
   /* 2 3 2                                                                       */
 
+  perfBegin(PERF_LOAD);
   cout << "Reading network " << argv[2] << "..." << flush;
   ifstream net(argv[2]);
   int Nnode = 0;
@@ -142,6 +179,7 @@ int main(int argc,char *argv[]){
 
   //Swap vector to free memory
   vector<pair<int,int> >().swap(Links); 
+  perfEnd(PERF_LOAD);
   
   // Initiation
   GreedyBase* greedy;
@@ -153,6 +191,8 @@ int main(int argc,char *argv[]){
      
   int Nmod = greedy->Nnode;
   cout << "Done! Code length " << greedy->codeLength << " in " << Nmod << " modules." << endl; 
+  perfPrint(cout);
+  allocPrint(cout);
     
   // Print partitions in Pajek's .clu format
   vector<int> clusterVec = vector<int>(Nnode);
@@ -195,33 +235,41 @@ int main(int argc,char *argv[]){
      
 }
 
-void partition(MTRand *R,Node ***node, GreedyBase *greedy, bool silent){
+void partition(Random *R,Node ***node, GreedyBase *greedy, bool silent, bool trial){
   
   int Nnode = greedy->Nnode;
   int Nmem = greedy->Nmem;
   int Nlinks = greedy->Nlinks;
 
+  perfBegin(PERF_COPY);
   Node **cpy_node = new Node*[Nnode];
   for(int i=0;i<Nnode;i++){
     cpy_node[i] = new Node();
     cpyNode(cpy_node[i],(*node)[i]);
   }
+  perfEnd(PERF_COPY);
   
   int iteration = 0;
+  double firstCodeLength = 0.0;
+  bool abandoned = false;
   double outer_oldCodeLength;
   do{
     outer_oldCodeLength = greedy->codeLength;
     
     if((iteration > 0) && (iteration % 2 == 0) && (greedy->Nnode > 1)){  // Partition the partition
       
+      PerfRegion region(PERF_SUBMODULE);
+      
       if(!silent)
 	cout << "Iteration " << iteration+1 << ", moving " << flush;
       
+      perfBegin(PERF_COPY);
       Node **rpt_node = new Node*[Nnode];
       for(int i=0;i<Nnode;i++){
 	rpt_node[i] = new Node();
 	cpyNode(rpt_node[i],cpy_node[i]);
       }
+      perfEnd(PERF_COPY);
       int *subMoveTo = new int[Nnode];
       int *moveTo = new int[Nnode];
       int subModIndex = 0;
@@ -233,40 +281,16 @@ void partition(MTRand *R,Node ***node, GreedyBase *greedy, bool silent){
 	if(sub_Nnode > 1){
 	  
 	  Node **sub_node = new Node*[sub_Nnode]; 
-	  set<int> sub_mem;
-	  for(int j=0;j<sub_Nnode;j++)
-	    sub_mem.insert((*node)[i]->members[j]);
-	  set<int>::iterator it_mem = sub_mem.begin();
-	  int *sub_renumber = new int[Nnode];
-	  int *sub_rev_renumber = new int[sub_Nnode];
-	  int sub_Nlinks = 0;
-	  for(int j=0;j<sub_Nnode;j++){
-
-	    int orig_nr = (*it_mem);
-	    int orig_Nlinks = cpy_node[orig_nr]->links.size();
-	    sub_renumber[orig_nr] = j;
-	    sub_rev_renumber[j] = orig_nr;
-	    sub_node[j] = new Node(j);
-	    for(int k=0;k<orig_Nlinks;k++){
-	      int orig_link = cpy_node[orig_nr]->links[k].first;
-	      int orig_link_newnr = sub_renumber[orig_link];
-	      int orig_weight = cpy_node[orig_nr]->links[k].second;
-	      if(orig_link < orig_nr){
-		if(sub_mem.find(orig_link) != sub_mem.end()){
-		  sub_node[j]->links.push_back(make_pair(orig_link_newnr,orig_weight));
-		  sub_node[orig_link_newnr]->links.push_back(make_pair(j,orig_weight));
-		  sub_Nlinks += orig_weight;
-		}
-	      }
-	    }
-	    it_mem++;
-	  }
+	  vector<int> sub_rev_renumber((*node)[i]->members);
+	  sort(sub_rev_renumber.begin(),sub_rev_renumber.end());
+	  int sub_Nlinks = extractSubNet(cpy_node,Nnode,sub_rev_renumber,sub_node);
 	  
 
+	  Random sub_R = R->split(); // Own stream for each submodule
 	  GreedyBase* sub_greedy;
-	  sub_greedy = new Greedy(R,sub_Nnode,sub_Nlinks,sub_node);
+	  sub_greedy = new Greedy(&sub_R,sub_Nnode,sub_Nlinks,sub_node);
 	  sub_greedy->initiate();
-	  partition(R,&sub_node,sub_greedy,true);
+	  partition(&sub_R,&sub_node,sub_greedy,true,false);
 
 	  for(int j=0;j<sub_greedy->Nnode;j++){
 	    int Nmembers = sub_node[j]->members.size();
@@ -280,8 +304,6 @@ void partition(MTRand *R,Node ***node, GreedyBase *greedy, bool silent){
 	  
 	  delete [] sub_node;
 	  delete sub_greedy;
-	  delete [] sub_renumber;
-	  delete [] sub_rev_renumber;
 	  
 	}
 	else{
@@ -322,11 +344,13 @@ void partition(MTRand *R,Node ***node, GreedyBase *greedy, bool silent){
       if(!silent)
 	cout << "Iteration " << iteration+1 << ", moving " << Nnode << " nodes, looping ";
 
+      perfBegin(PERF_COPY);
       Node **rpt_node = new Node*[Nnode];
       for(int i=0;i<Nnode;i++){
 	rpt_node[i] = new Node();
 	cpyNode(rpt_node[i],cpy_node[i]);
       }
+      perfEnd(PERF_COPY);
       
      
 
@@ -376,7 +400,7 @@ void partition(MTRand *R,Node ***node, GreedyBase *greedy, bool silent){
 	double inner_oldCodeLength = greedy->codeLength;
 	greedy->move(moved);
 	Nloops++;
-	if(inner_oldCodeLength-greedy->codeLength < 1.0e-10)
+	if(inner_oldCodeLength-greedy->codeLength < 1.0e-10 || budgetSpent())
 	  moved = false;
       }
       
@@ -385,13 +409,26 @@ void partition(MTRand *R,Node ***node, GreedyBase *greedy, bool silent){
       if(!silent)
 	cout << Nloops << " ";
 
-    } while(oldCodeLength - greedy->codeLength >  1.0e-10);
+    } while(oldCodeLength - greedy->codeLength >  1.0e-10 && !budgetSpent());
  
     iteration++;
     if(!silent)
       cout << "times between mergings to code length " <<  greedy->codeLength << " in " << greedy->Nmod << " modules." << " Link penalty is " << greedy->penalty << " with penalty factor " << greedy->pF << "." <<  endl;
   
-  } while(outer_oldCodeLength - greedy->codeLength > 1.0e-10);
+    // Give up attempts that cannot be expected to beat the best one
+    if(trial && iteration == 1){
+      firstCodeLength = greedy->codeLength;
+      if(budgetHopeless(firstCodeLength)){
+        if(!silent)
+          cout << "Abandoning the attempt, it is not expected to beat the best code length." << endl;
+        abandoned = true;
+        break;
+      }
+    }
+    
+  } while(outer_oldCodeLength - greedy->codeLength > 1.0e-10 && !budgetSpent());
+  if(trial && !abandoned)
+    budgetRecordTrial(firstCodeLength,greedy->codeLength);
 
   
   for(int i=0;i<Nnode;i++)
@@ -400,34 +437,44 @@ void partition(MTRand *R,Node ***node, GreedyBase *greedy, bool silent){
  
 }
 
-void repeated_partition(MTRand *R, Node ***node, GreedyBase *greedy, bool silent,int Ntrials){
+void repeated_partition(Random *R, Node ***node, GreedyBase *greedy, bool silent,int Ntrials){
   
   double shortestCodeLength = 1.0e10;
   int Nnode = greedy->Nnode;
   int *cluster = new int[Nnode];
 
-  for(int trial = 0; trial<Ntrials;trial++){
+  int Nstale = 0; // Attempts since the last improvement
+  for(int trial = 0; budgetNextTrial(trial,Ntrials,Nstale,silent); trial++){
     
     if(!silent && greedy->pF < 0.5)
-      cout << "Attempt " << trial+1 << "/" << Ntrials << endl;
+      cout << "Attempt " << trial+1 << (Ntrials > 0 ? "/" + to_string(Ntrials) : string("")) << endl;
     
+    perfBegin(PERF_COPY);
     Node **cpy_node = new Node*[Nnode];
     for(int i=0;i<Nnode;i++){
       cpy_node[i] = new Node();
       cpyNode(cpy_node[i],(*node)[i]);
     }
+    perfEnd(PERF_COPY);
     
     greedy->Nnode = Nnode;
     greedy->Nmod = Nnode;
     greedy->node = cpy_node;
     greedy->initiate();
     
-    partition(R,&cpy_node,greedy,silent);
+    Random trial_R = R->split(trial); // Own stream for each trial
+    greedy->setRandom(&trial_R);
+    partition(&trial_R,&cpy_node,greedy,silent,true);
  
     if(!silent && greedy->penalty == 0){
+      if(greedy->codeLength < shortestCodeLength - 1.0e-10)
+        Nstale = 0;
+      else
+        Nstale++;
       if(greedy->codeLength < shortestCodeLength){
 	
 	shortestCodeLength = greedy->codeLength;
+	budgetOffer(shortestCodeLength);
 	
 	// Store best partition
 	for(int i=0;i<greedy->Nnode;i++){
@@ -440,11 +487,14 @@ void repeated_partition(MTRand *R, Node ***node, GreedyBase *greedy, bool silent
     }
     else{
             
-      if(greedy->pF < 5){
+      if(greedy->pF < 5 && !budgetSpent()){
 	trial--;
 	greedy->pF += 0.5;
 	cout << "One or more modules have more links across boundary than within, increasing the penalty factor and trying again..." << endl;
       }
+      else if(greedy->pF < 5 && shortestCodeLength < 1.0e10){
+	cout << "One or more modules have more links across boundary than within, keeping the best partition so far..." << endl;
+      }
       else{
 	cout << "One or more modules still have more links across boundary than within, giving up..." << endl;
 	// Store partition
@@ -463,6 +513,8 @@ void repeated_partition(MTRand *R, Node ***node, GreedyBase *greedy, bool silent
     
   }
   
+  greedy->setRandom(R);
+  
   // Commit best partition
   greedy->Nnode = Nnode;
   greedy->Nmod = Nnode;
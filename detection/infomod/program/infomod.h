@@ -7,10 +7,14 @@
 #include <sstream>
 #include <fstream>
 #include <iomanip>
-#include "MersenneTwister.h"
+#include "Random.h"
 #include "GreedyBase.h" 
 #include "Greedy.h" 
 #include "Node.h" 
+#include "PerfCounters.h"
+#include "AllocTracker.h"
+#include "Budget.h"
+#include "SubNet.h"
 #define PI 3.14159265
 using namespace std;
 
@@ -29,6 +33,14 @@ inline std::string to_string (const T& t){
   return ss.str();
 }
 
+// Index of the first --option argument, or argc if there are none
+int firstOption(int argc,char *argv[]){
+  for(int i=1;i<argc;i++)
+    if(strncmp(argv[i],"--",2) == 0)
+      return i;
+  return argc;
+}
+
 
 void cpyNode(Node *newNode,Node *oldNode){
   